@@ -1,12 +1,22 @@
-#include <opencv/cv.h>
-#include <opencv/cxmisc.h>
-#include <opencv/cvaux.h>
-#include <opencv/highgui.h>
+#include "opencv2/core/core.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+#include "opencv2/calib3d/calib3d.hpp"
+#include "opencv2/highgui/highgui.hpp"
+
+#include "calib_errors.hpp"
+#include "detect.hpp"
+#include "disparity.hpp"
+#include "image_cache.hpp"
+#include "image_loader.hpp"
+#include "robust_calib.hpp"
 
 #include <vector>
 #include <string>
 #include <algorithm>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
 #include <ctype.h>
 using namespace std;
 using namespace cv;
@@ -21,44 +31,36 @@ StereoCalib(const char* imageList, int nx, int ny, int useUncalibrated)
 {
 	int displayCorners = 0;
 	int showUndistorted = 1;
+	int usePrefilter = 0; //skip blurred or board-less frames (mayContainBoard);
+	//may drop a hard but usable image of a hand-picked list
 	bool isVerticalStereo = false;//OpenCV can handle left-right
 	//or up-down camera arrangements
 	const int maxScale = 1;
 	const float squareSize = 1.f; //Set this to your actual square size
 	FILE* f = fopen(imageList, "rt");
-	int i, j, lr, nframes, n = nx*ny, N = 0;
+	int i, j, lr, nframes;
+	Size boardSize(nx, ny);
 	vector<string> imageNames[2];
-	vector<CvPoint3D32f> objectPoints;
-	vector<CvPoint2D32f> points[2];
-	vector<int> npoints;
+	vector<vector<Point3f> > objectPoints;
+	vector<vector<Point2f> > points[2];
 	vector<uchar> active[2];
-	vector<CvPoint2D32f> temp(n);
-	CvSize imageSize = {0,0};
+	Size imageSize;
 	// ARRAY AND VECTOR STORAGE:
-	double M1[3][3], M2[3][3], D1[5], D2[5];
-	double R[3][3], T[3], E[3][3], F[3][3];
-	CvMat _M1 = cvMat(3, 3, CV_64F, M1 );
-	CvMat _M2 = cvMat(3, 3, CV_64F, M2 );
-	CvMat _D1 = cvMat(1, 5, CV_64F, D1 );
-	CvMat _D2 = cvMat(1, 5, CV_64F, D2 );
-	CvMat _R = cvMat(3, 3, CV_64F, R );
-	CvMat _T = cvMat(3, 1, CV_64F, T );
-	CvMat _E = cvMat(3, 3, CV_64F, E );
-	CvMat _F = cvMat(3, 3, CV_64F, F );
+	Mat M1 = Mat::eye(3, 3, CV_64F), M2 = Mat::eye(3, 3, CV_64F);
+	Mat D1 = Mat::zeros(1, 5, CV_64F), D2 = Mat::zeros(1, 5, CV_64F);
+	Mat R, T, E, F;
 	if( displayCorners )
-		cvNamedWindow( "corners", 1 );
+		namedWindow( "corners", 1 );
 	// READ IN THE LIST OF CHESSBOARDS:
 	if( !f )
 	{
 		fprintf(stderr, "can not open file %s\n", imageList );
 		return;
 	}
-	for(i=0;;i++)
+	vector<string> fileList;
+	for(;;)
 	{
 		char buf[1024];
-		int count = 0, result=0;
-		lr = i % 2;
-		vector<CvPoint2D32f>& pts = points[lr];
 		if( !fgets( buf, sizeof(buf)-3, f ))
 			break;
 		size_t len = strlen(buf);
@@ -66,165 +68,169 @@ StereoCalib(const char* imageList, int nx, int ny, int useUncalibrated)
 			buf[--len] = '\0';
 		if( buf[0] == '#')
 			continue;
-		IplImage* img = cvLoadImage( buf, 0 );
-		if( !img )
+		fileList.push_back(buf);
+	}
+	fclose(f);
+	for( lr = 0; lr < 2; lr++ )
+	{
+		imageNames[lr].reserve(fileList.size()/2 + 1);
+		points[lr].reserve(fileList.size()/2 + 1);
+		active[lr].reserve(fileList.size()/2 + 1);
+	}
+	//The next few images are decoded in the background
+	//while the chessboard is searched in the current one
+	ImagePrefetcher loader(fileList, 0, 1, 4);
+	//Decoded images are kept for the rectification pass below
+	ImageCache imageCache(showUndistorted ? 1024u << 20 : 0);
+	Mat cimg;
+	int nskipped = 0;
+	for(i=0;i<(int)fileList.size();i++)
+	{
+		const char* buf = fileList[i].c_str();
+		lr = i % 2;
+		Mat img = loader.take(i);
+		if( img.empty() )
 			break;
-		imageSize = cvGetSize(img);
+		imageSize = img.size();
 		imageNames[lr].push_back(buf);
+		imageCache.put(fileList[i], img);
 		//FIND CHESSBOARDS AND CORNERS THEREIN:
-		for( int s = 1; s <= maxScale; s++ )
-		{
-			IplImage* timg = img;
-			if( s > 1 )
-			{
-				timg = cvCreateImage(cvSize(img->width*s,img->height*s),
-				img->depth, img->nChannels );
-				cvResize( img, timg, CV_INTER_CUBIC );
-			}
-			result = cvFindChessboardCorners( timg, cvSize(nx, ny),
-			&temp[0], &count,
-			CV_CALIB_CB_ADAPTIVE_THRESH |
-			CV_CALIB_CB_NORMALIZE_IMAGE);
-			if( timg != img )
-				cvReleaseImage( &timg );
-			if( result || s == maxScale )
-				for( j = 0; j < count; j++ )
-				{
-					temp[j].x /= s;
-					temp[j].y /= s;
-				}
-			if( result )
-				break;
-		}
+		//(refined to subpixel accuracy, calibration suffers without it)
+		points[lr].push_back(vector<Point2f>());
+		vector<Point2f>& corners = points[lr].back();
+		//blurred or board-less frames skip the expensive search
+		bool result = false;
+		if( !usePrefilter || mayContainBoard(img, boardSize) )
+			result = findBoardCorners(img, boardSize, corners, maxScale);
+		else
+			nskipped++;
 		if( displayCorners )
 		{
 			printf("%s\n", buf);
-			IplImage* cimg = cvCreateImage( imageSize, 8, 3 );
-			cvCvtColor( img, cimg, CV_GRAY2BGR );
-			cvDrawChessboardCorners( cimg, cvSize(nx, ny), &temp[0],
-			count, result );
-			cvShowImage( "corners", cimg );
-			cvReleaseImage( &cimg );
-			if( cvWaitKey(0) == 27 ) //Allow ESC to quit
+			cvtColor( img, cimg, COLOR_GRAY2BGR );
+			drawChessboardCorners( cimg, boardSize, corners, result );
+			imshow( "corners", cimg );
+			if( waitKey(0) == 27 ) //Allow ESC to quit
 				exit(-1);
 		}
 		else
 			putchar('.');
-		N = pts.size();
-		pts.resize(N + n, cvPoint2D32f(0,0));
 		active[lr].push_back((uchar)result);
-		//assert( result != 0 );
-		if( result )
+	}
+	printf("\n");
+	if( nskipped > 0 )
+		printf("%d images skipped by the prefilter\n", nskipped);
+	printf("decoding took %g s, detection stalled %g s waiting for images\n",
+		loader.decodeSeconds(), loader.stallSeconds());
+	// KEEP THE PAIRS FOUND IN BOTH VIEWS:
+	nframes = (int)std::min(active[0].size(), active[1].size());
+	for( i = j = 0; i < nframes; i++ )
+	{
+		if( !active[0][i] || !active[1][i] )
+			continue;
+		for( lr = 0; lr < 2; lr++ )
 		{
-			//Calibration will suffer without subpixel interpolation
-			cvFindCornerSubPix( img, &temp[0], count,
-			cvSize(11, 11), cvSize(-1,-1),
-			cvTermCriteria(CV_TERMCRIT_ITER+CV_TERMCRIT_EPS,
-			30, 0.01) );
-			copy( temp.begin(), temp.end(), pts.begin() + N );
+			if( j < i )
+			{
+				points[lr][j].swap(points[lr][i]);
+				imageNames[lr][j].swap(imageNames[lr][i]);
+			}
 		}
-		cvReleaseImage( &img );
+		j++;
+	}
+	nframes = j;
+	for( lr = 0; lr < 2; lr++ )
+	{
+		points[lr].resize(nframes);
+		imageNames[lr].resize(nframes);
+	}
+	printf("%d pairs have been successfully detected.\n", nframes);
+	if( nframes < 2 )
+	{
+		fprintf(stderr, "too little pairs to run the calibration\n");
+		return;
 	}
-	fclose(f);
-	printf("\n");
 	// HARVEST CHESSBOARD 3D OBJECT POINT LIST:
-	nframes = active[0].size();//Number of good chessboads found
-	objectPoints.resize(nframes*n);
+	objectPoints.resize(1);
 	for( i = 0; i < ny; i++ )
 	for( j = 0; j < nx; j++ )
-		objectPoints[i*nx + j] = cvPoint3D32f(i*squareSize, j*squareSize, 0);
-	for( i = 1; i < nframes; i++ )
-		copy( objectPoints.begin(), objectPoints.begin() + n, objectPoints.begin() + i*n );
-	npoints.resize(nframes,n);
-	N = nframes*n;
-	CvMat _objectPoints = cvMat(1, N, CV_32FC3, &objectPoints[0] );
-	CvMat _imagePoints1 = cvMat(1, N, CV_32FC2, &points[0][0] );
-	CvMat _imagePoints2 = cvMat(1, N, CV_32FC2, &points[1][0] );
-	CvMat _npoints = cvMat(1, npoints.size(), CV_32S, &npoints[0] );
-	cvSetIdentity(&_M1);
-	cvSetIdentity(&_M2);
-	cvZero(&_D1);
-	cvZero(&_D2);
+		objectPoints[0].push_back(Point3f(i*squareSize, j*squareSize, 0));
+	objectPoints.resize(nframes, objectPoints[0]);
 	// CALIBRATE THE STEREO CAMERAS
 	printf("Running stereo calibration ...");
 	fflush(stdout);
-	cvStereoCalibrate( &_objectPoints, &_imagePoints1,
-	&_imagePoints2, &_npoints,
-	&_M1, &_D1, &_M2, &_D2,
-	imageSize, &_R, &_T, &_E, &_F,
-	cvTermCriteria(CV_TERMCRIT_ITER+
-	CV_TERMCRIT_EPS, 100, 1e-5),
-	CV_CALIB_FIX_ASPECT_RATIO +
-	CV_CALIB_ZERO_TANGENT_DIST +
-	CV_CALIB_SAME_FOCAL_LENGTH );
+	const TermCriteria criteria(TermCriteria::COUNT+
+	TermCriteria::EPS, 100, 1e-5);
+	const int flags = CALIB_FIX_ASPECT_RATIO +
+	CALIB_ZERO_TANGENT_DIST +
+	CALIB_SAME_FOCAL_LENGTH;
+	//Pairs whose epipolar error is far above the rest are dropped
+	//and the calibration re-solved without them
+	Mat M[2] = { M1, M2 }, D[2] = { D1, D2 };
+	vector<int> kept;
+	vector<StereoRound> rounds;
+	robustStereoCalibrate( objectPoints, points, M, D, imageSize,
+	R, T, E, F, flags, criteria, OutlierRejection(), kept, &rounds );
+	M1 = M[0]; M2 = M[1]; D1 = D[0]; D2 = D[1];
 	printf(" done\n");
+	for( i = 0; i < (int)rounds.size(); i++ )
+	{
+		printf("round %d: rms %g, %g ms\n", i, rounds[i].rms, rounds[i].ms);
+		for( j = 0; j < (int)rounds[i].dropped.size(); j++ )
+			printf("dropped the outlier pair %s, %s\n",
+			imageNames[0][rounds[i].dropped[j]].c_str(),
+			imageNames[1][rounds[i].dropped[j]].c_str());
+	}
+	for( i = 0; i < (int)kept.size(); i++ )
+		for( lr = 0; lr < 2; lr++ )
+			imageNames[lr][i] = imageNames[lr][kept[i]];
+	nframes = (int)kept.size();
+	for( lr = 0; lr < 2; lr++ )
+		imageNames[lr].resize(nframes);
 	// CALIBRATION QUALITY CHECK
 	// because the output fundamental matrix implicitly
 	// includes all the output information,
 	// we can check the quality of calibration using the
 	// epipolar geometry constraint: m2^t*F*m1=0
-	vector<CvPoint3D32f> lines[2];
-	points[0].resize(N);
-	points[1].resize(N);
-	_imagePoints1 = cvMat(1, N, CV_32FC2, &points[0][0] );
-	_imagePoints2 = cvMat(1, N, CV_32FC2, &points[1][0] );
-	lines[0].resize(N);
-	lines[1].resize(N);
-	CvMat _L1 = cvMat(1, N, CV_32FC3, &lines[0][0]);
-	CvMat _L2 = cvMat(1, N, CV_32FC3, &lines[1][0]);
+	//All points of all views in one row each, as the uncalibrated
+	//rectification below wants them
+	int N = nframes*nx*ny;
+	Mat imagePoints1(1, N, CV_32FC2), imagePoints2(1, N, CV_32FC2);
+	for( i = 0; i < nframes; i++ )
+	{
+		Mat(points[0][i]).reshape(2, 1).copyTo(imagePoints1.colRange(i*nx*ny, (i+1)*nx*ny));
+		Mat(points[1][i]).reshape(2, 1).copyTo(imagePoints2.colRange(i*nx*ny, (i+1)*nx*ny));
+	}
 	//Always work in undistorted space
-	cvUndistortPoints( &_imagePoints1, &_imagePoints1,
-	&_M1, &_D1, 0, &_M1 );
-	cvUndistortPoints( &_imagePoints2, &_imagePoints2,
-	&_M2, &_D2, 0, &_M2 );
-	cvComputeCorrespondEpilines( &_imagePoints1, 1, &_F, &_L1 );
-	cvComputeCorrespondEpilines( &_imagePoints2, 2, &_F, &_L2 );
+	undistortPoints( imagePoints1, imagePoints1, M1, D1, noArray(), M1 );
+	undistortPoints( imagePoints2, imagePoints2, M2, D2, noArray(), M2 );
+	vector<float> epipolarErrs;
+	epipolarPointErrors( imagePoints1, imagePoints2, F, epipolarErrs );
 	double avgErr = 0;
 	for( i = 0; i < N; i++ )
-	{
-		double err = fabs(points[0][i].x*lines[1][i].x +
-		points[0][i].y*lines[1][i].y + lines[1][i].z)
-		+ fabs(points[1][i].x*lines[0][i].x +
-		points[1][i].y*lines[0][i].y + lines[0][i].z);
-		avgErr += err;
-	}
-	printf( "avg err = %g\n", avgErr/(nframes*n) );
+		avgErr += epipolarErrs[i];
+	printf( "avg err = %g\n", avgErr/N );
 	//COMPUTE AND DISPLAY RECTIFICATION
 	if( showUndistorted )
 	{
-		CvMat* mx1 = cvCreateMat( imageSize.height,
-		imageSize.width, CV_32F );
-		CvMat* my1 = cvCreateMat( imageSize.height,
-		imageSize.width, CV_32F );
-		CvMat* mx2 = cvCreateMat( imageSize.height,
-		imageSize.width, CV_32F );
-		CvMat* my2 = cvCreateMat( imageSize.height,
-		imageSize.width, CV_32F );
-		CvMat* img1r = cvCreateMat( imageSize.height,
-		imageSize.width, CV_8U );
-		CvMat* img2r = cvCreateMat( imageSize.height,
-		imageSize.width, CV_8U );
-		CvMat* disp = cvCreateMat( imageSize.height,
-		imageSize.width, CV_16S );
-		CvMat* vdisp = cvCreateMat( imageSize.height,
-		imageSize.width, CV_8U );
-		CvMat* pair;
-		double R1[3][3], R2[3][3], P1[3][4], P2[3][4];
-		CvMat _R1 = cvMat(3, 3, CV_64F, R1);
-		CvMat _R2 = cvMat(3, 3, CV_64F, R2);
+		//All per-frame buffers are allocated once here and reused,
+		//so long lists run without heap churn
+		Mat mx1, my1, mx2, my2;
+		Mat img1r(imageSize, CV_8U), img2r(imageSize, CV_8U);
+		Mat disp(imageSize, CV_16S), vdisp(imageSize, CV_8U);
+		Mat pair;
+		Mat R1, R2, P1, P2, Q;
 		// IF BY CALIBRATED (BOUGUET'S METHOD)
 		if( useUncalibrated == 0 )
 		{
-			CvMat _P1 = cvMat(3, 4, CV_64F, P1);
-			CvMat _P2 = cvMat(3, 4, CV_64F, P2);
-			cvStereoRectify( &_M1, &_M2, &_D1, &_D2, imageSize,
-			&_R, &_T,
-			&_R1, &_R2, &_P1, &_P2, 0,
-			0/*CV_CALIB_ZERO_DISPARITY*/ );
-			isVerticalStereo = fabs(P2[1][3]) > fabs(P2[0][3]);
-			//Precompute maps for cvRemap()
-			cvInitUndistortRectifyMap(&_M1,&_D1,&_R1,&_P1,mx1,my1);
-			cvInitUndistortRectifyMap(&_M2,&_D2,&_R2,&_P2,mx2,my2);
+			stereoRectify( M1, D1, M2, D2, imageSize,
+			R, T,
+			R1, R2, P1, P2, Q,
+			0/*CALIB_ZERO_DISPARITY*/ );
+			isVerticalStereo = fabs(P2.at<double>(1, 3)) > fabs(P2.at<double>(0, 3));
+			//Precompute maps for remap()
+			initUndistortRectifyMap(M1, D1, R1, P1, imageSize, CV_16SC2, mx1, my1);
+			initUndistortRectifyMap(M2, D2, R2, P2, imageSize, CV_16SC2, mx2, my2);
 		}
 		//OR ELSE HARTLEY'S METHOD
 		else if( useUncalibrated == 1 || useUncalibrated == 2 )
@@ -232,52 +238,53 @@ StereoCalib(const char* imageList, int nx, int ny, int useUncalibrated)
 		// compute the rectification transformation directly
 		// from the fundamental matrix
 		{
-			double H1[3][3], H2[3][3], iM[3][3];
-			CvMat _H1 = cvMat(3, 3, CV_64F, H1);
-			CvMat _H2 = cvMat(3, 3, CV_64F, H2);
-			CvMat _iM = cvMat(3, 3, CV_64F, iM);
+			Mat H1, H2;
 			//Just to show you could have independently used F
 			if( useUncalibrated == 2 )
-				cvFindFundamentalMat( &_imagePoints1, &_imagePoints2, &_F);
-			cvStereoRectifyUncalibrated( &_imagePoints1, &_imagePoints2, &_F, imageSize,
-										 &_H1, &_H2, 3);
-			cvInvert(&_M1, &_iM);
-			cvMatMul(&_H1, &_M1, &_R1);
-			cvMatMul(&_iM, &_R1, &_R1);
-			cvInvert(&_M2, &_iM);
-			cvMatMul(&_H2, &_M2, &_R2);
-			cvMatMul(&_iM, &_R2, &_R2);
-			//Precompute map for cvRemap()
-			cvInitUndistortRectifyMap(&_M1,&_D1,&_R1,&_M1,mx1,my1);
-			cvInitUndistortRectifyMap(&_M2,&_D1,&_R2,&_M2,mx2,my2);
+				F = findFundamentalMat( imagePoints1, imagePoints2, FM_RANSAC, 3, 0.99 );
+			stereoRectifyUncalibrated( imagePoints1, imagePoints2, F, imageSize,
+										 H1, H2, 3);
+			R1 = M1.inv()*H1*M1;
+			R2 = M2.inv()*H2*M2;
+			//Precompute map for remap()
+			initUndistortRectifyMap(M1, D1, R1, M1, imageSize, CV_16SC2, mx1, my1);
+			initUndistortRectifyMap(M2, D1, R2, M2, imageSize, CV_16SC2, mx2, my2);
 		}
 		else
 			assert(0);
-		cvNamedWindow( "rectified", 1 );
+		namedWindow( "rectified", 1 );
 		// RECTIFY THE IMAGES AND FIND DISPARITY MAPS
 		if( !isVerticalStereo )
-			pair = cvCreateMat( imageSize.height, imageSize.width*2, CV_8UC3 );
+			pair.create( imageSize.height, imageSize.width*2, CV_8UC3 );
 		else
-			pair = cvCreateMat( imageSize.height*2, imageSize.width, CV_8UC3 );
-		//Setup for finding stereo correspondences
-		CvStereoBMState *BMState = cvCreateStereoBMState();
-		assert(BMState != 0);
-		BMState->preFilterSize=41;
-		BMState->preFilterCap=31;
-		BMState->SADWindowSize=41;
-		BMState->minDisparity=-64;
-		BMState->numberOfDisparities=128;
-		BMState->textureThreshold=10;
-		BMState->uniquenessRatio=15;
+			pair.create( imageSize.height*2, imageSize.width, CV_8UC3 );
+		Mat part1 = !isVerticalStereo ? pair.colRange(0, imageSize.width) : pair.rowRange(0, imageSize.height);
+		Mat part2 = !isVerticalStereo ? pair.colRange(imageSize.width, imageSize.width*2) :
+										pair.rowRange(imageSize.height, imageSize.height*2);
+		//Setup for finding stereo correspondences,
+		//matched in strips on all cores; OpenCV's own
+		//threads would only compete with the strip workers
+		setNumThreads(1);
+		DisparityParams dp;
+		dp.numDisparities = 128;
+		dp.blockSize = 41;
+		dp.preFilterSize = 41;
+		dp.preFilterCap = 31;
+		dp.minDisparity = -64;
+		dp.textureThreshold = 10;
+		dp.uniquenessRatio = 15;
+		DisparityEngine bm( dp );
+		Mat img1, img2;
 		for( i = 0; i < nframes; i++ )
 		{
-			IplImage* img1=cvLoadImage(imageNames[0][i].c_str(),0);
-			IplImage* img2=cvLoadImage(imageNames[1][i].c_str(),0);
-			if( img1 && img2 )
+			if( !imageCache.get(imageNames[0][i], img1) )
+				img1 = imread(imageNames[0][i], 0);
+			if( !imageCache.get(imageNames[1][i], img2) )
+				img2 = imread(imageNames[1][i], 0);
+			if( !img1.empty() && !img2.empty() )
 			{
-				CvMat part;
-				cvRemap( img1, img1r, mx1, my1 );
-				cvRemap( img2, img2r, mx2, my2 );
+				remap( img1, img1r, mx1, my1, INTER_LINEAR );
+				remap( img2, img2r, mx2, my2, INTER_LINEAR );
 				if( !isVerticalStereo || useUncalibrated != 0 )
 				{
 					// When the stereo camera is oriented vertically,
@@ -285,55 +292,37 @@ StereoCalib(const char* imageList, int nx, int ny, int useUncalibrated)
 					// image, so the epipolar lines in the rectified
 					// images are vertical. Stereo correspondence
 					// function does not support such a case.
-					cvFindStereoCorrespondenceBM( img1r, img2r, disp,
-					BMState);
-					cvNormalize( disp, vdisp, 0, 256, CV_MINMAX );
-					cvNamedWindow( "disparity" );
-					cvShowImage( "disparity", vdisp );
+					bm.compute( img1r, img2r, disp );
+					normalize( disp, vdisp, 0, 256, NORM_MINMAX, CV_8U );
+					namedWindow( "disparity" );
+					imshow( "disparity", vdisp );
 				}
+				//the color conversions write straight into the canvas
+				cvtColor( img1r, part1, COLOR_GRAY2BGR );
+				cvtColor( img2r, part2, COLOR_GRAY2BGR );
 				if( !isVerticalStereo )
 				{
-					cvGetCols( pair, &part, 0, imageSize.width );
-					cvCvtColor( img1r, &part, CV_GRAY2BGR );
-					cvGetCols( pair, &part, imageSize.width,
-					imageSize.width*2 );
-					cvCvtColor( img2r, &part, CV_GRAY2BGR );
 					for( j = 0; j < imageSize.height; j += 16 )
-					cvLine( pair, cvPoint(0,j),
-					cvPoint(imageSize.width*2,j),
-					CV_RGB(0,255,0));
+					line( pair, Point(0,j),
+					Point(imageSize.width*2,j),
+					Scalar(0,255,0));
 				}
 				else
 				{
-					cvGetRows( pair, &part, 0, imageSize.height );
-					cvCvtColor( img1r, &part, CV_GRAY2BGR );
-					cvGetRows( pair, &part, imageSize.height,
-					imageSize.height*2 );
-					cvCvtColor( img2r, &part, CV_GRAY2BGR );
 					for( j = 0; j < imageSize.width; j += 16 )
-					cvLine( pair, cvPoint(j,0),
-					cvPoint(j,imageSize.height*2),
-					CV_RGB(0,255,0));
+					line( pair, Point(j,0),
+					Point(j,imageSize.height*2),
+					Scalar(0,255,0));
 				}
-				cvShowImage( "rectified", pair );
-				if( cvWaitKey() == 27 )
+				imshow( "rectified", pair );
+				if( waitKey() == 27 )
 					break;
 			}
-			cvReleaseImage( &img1 );
-			cvReleaseImage( &img2 );
 		}
-		cvReleaseStereoBMState(&BMState);
-		cvReleaseMat( &mx1 );
-		cvReleaseMat( &my1 );
-		cvReleaseMat( &mx2 );
-		cvReleaseMat( &my2 );
-		cvReleaseMat( &img1r );
-		cvReleaseMat( &img2r );
-		cvReleaseMat( &disp );
 	}
 }
 /*int main(void)
 {
 	StereoCalib("list.txt", 9, 6, 1);
 	return 0;
-}*/
\ No newline at end of file
+}*/
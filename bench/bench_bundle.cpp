@@ -0,0 +1,183 @@
+// Benchmark of the sparse calibration solver.
+//
+// Projects a chessboard into a synthetic camera under random poses, adds
+// pixel noise and calibrates growing view sets with calibrateCamera and
+// with sparseCalibrateCamera. Reports the solve time of both, the RMS
+// error and how far the focal length is off the truth. calibrateCamera is
+// skipped above -dense views, where it gets too slow to wait for.
+
+#include "opencv2/core/core.hpp"
+#include "opencv2/calib3d/calib3d.hpp"
+
+#include "../bundle_adjust.hpp"
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <iostream>
+#include <stdio.h>
+#include <math.h>
+
+using namespace cv;
+using namespace std;
+
+static int print_help()
+{
+    cout << " Calibrates synthetic view sets of growing size with calibrateCamera and\n"
+            " with the sparse solver and reports time and accuracy.\n" << endl;
+    cout << "Usage:\n ./bench_bundle [-views max_views] [-dense max_views /*for calibrateCamera*/]\n"
+            "   [-noise pixels] [-rational] [-t threads /*0 = one per core*/] [-seed n]\n" << endl;
+    return 0;
+}
+
+struct Camera
+{
+    Size imageSize;
+    Mat K, D;
+};
+
+// Random views of a boardSize board that fall completely into the image.
+static void makeViews(const Camera& cam, Size boardSize, float squareSize, int nviews, double noise,
+                      RNG& rng, vector<vector<Point3f> >& objectPoints, vector<vector<Point2f> >& imagePoints)
+{
+    vector<Point3f> board;
+    for( int i = 0; i < boardSize.height; i++ )
+        for( int j = 0; j < boardSize.width; j++ )
+            board.push_back(Point3f(j*squareSize, i*squareSize, 0));
+    Point3f center((boardSize.width - 1)*squareSize*0.5f, (boardSize.height - 1)*squareSize*0.5f, 0);
+    Rect_<float> frame(0.f, 0.f, (float)cam.imageSize.width, (float)cam.imageSize.height);
+
+    objectPoints.clear();
+    imagePoints.clear();
+    while( (int)imagePoints.size() < nviews )
+    {
+        double ax = rng.uniform(-0.6, 0.6), ay = rng.uniform(-0.6, 0.6), az = rng.uniform(-0.3, 0.3);
+        Mat rvec = (Mat_<double>(3, 1) << ax, ay, az), R;
+        Rodrigues(rvec, R);
+        double z = rng.uniform(400., 900.);
+        Mat c = R*Mat(Point3d(center));
+        Mat tvec = (Mat_<double>(3, 1) << rng.uniform(-0.3, 0.3)*z, rng.uniform(-0.2, 0.2)*z, z);
+        tvec -= c;
+
+        vector<Point2f> proj;
+        projectPoints(board, rvec, tvec, cam.K, cam.D, proj);
+        bool inside = true;
+        for( size_t k = 0; k < proj.size() && inside; k++ )
+        {
+            proj[k] += Point2f((float)rng.gaussian(noise), (float)rng.gaussian(noise));
+            inside = frame.contains(proj[k]);
+        }
+        if( !inside )
+            continue;
+        objectPoints.push_back(board);
+        imagePoints.push_back(proj);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int maxViews = 800, maxDense = 400, nthreads = 0, seed = 1;
+    double noise = 0.2;
+    bool rational = false;
+
+    for( int i = 1; i < argc; i++ )
+    {
+        string arg = argv[i];
+        bool hasValue = i+1 < argc;
+        if( arg == "-views" )
+        {
+            if( !hasValue || sscanf(argv[++i], "%d", &maxViews) != 1 || maxViews < 3 )
+            {
+                cout << "invalid view count" << endl;
+                return print_help();
+            }
+        }
+        else if( arg == "-dense" )
+        {
+            if( !hasValue || sscanf(argv[++i], "%d", &maxDense) != 1 || maxDense < 0 )
+            {
+                cout << "invalid view count" << endl;
+                return print_help();
+            }
+        }
+        else if( arg == "-noise" )
+        {
+            if( !hasValue || sscanf(argv[++i], "%lf", &noise) != 1 || noise < 0 )
+            {
+                cout << "invalid noise level" << endl;
+                return print_help();
+            }
+        }
+        else if( arg == "-rational" )
+            rational = true;
+        else if( arg == "-t" )
+        {
+            if( !hasValue || sscanf(argv[++i], "%d", &nthreads) != 1 || nthreads < 0 )
+            {
+                cout << "invalid thread count" << endl;
+                return print_help();
+            }
+        }
+        else if( arg == "-seed" )
+        {
+            if( !hasValue || sscanf(argv[++i], "%d", &seed) != 1 )
+            {
+                cout << "invalid seed" << endl;
+                return print_help();
+            }
+        }
+        else
+        {
+            cout << "invalid option " << arg << endl;
+            return print_help();
+        }
+    }
+
+    Camera cam;
+    cam.imageSize = Size(1280, 720);
+    cam.K = (Mat_<double>(3, 3) << 1000, 0, 640, 0, 1000, 360, 0, 0, 1);
+    cam.D = rational ? (Mat_<double>(8, 1) << -0.2, 0.05, 0.001, -0.0005, 0, 0.01, 0, 0) :
+                       (Mat_<double>(5, 1) << -0.2, 0.05, 0.001, -0.0005, 0);
+    int flags = rational ? CALIB_RATIONAL_MODEL : 0;
+
+    RNG rng(seed);
+    vector<vector<Point3f> > allObject;
+    vector<vector<Point2f> > allImage;
+    makeViews(cam, Size(9, 6), 30.f, maxViews, noise, rng, allObject, allImage);
+
+    printf("%8s %12s %10s %10s %12s %10s %10s\n", "views", "dense ms", "dense rms", "dense df",
+           "sparse ms", "sparse rms", "sparse df");
+    for( int n = std::min(25, maxViews); ; n = std::min(n*2, maxViews) )
+    {
+        vector<vector<Point3f> > objectPoints(allObject.begin(), allObject.begin() + n);
+        vector<vector<Point2f> > imagePoints(allImage.begin(), allImage.begin() + n);
+        vector<Mat> rvecs, tvecs;
+        Mat K, D;
+
+        double denseMs = -1, denseRms = 0, denseDf = 0;
+        if( n <= maxDense )
+        {
+            int64 t0 = getTickCount();
+            denseRms = calibrateCamera(objectPoints, imagePoints, cam.imageSize, K, D, rvecs, tvecs, flags);
+            denseMs = (getTickCount() - t0)*1000./getTickFrequency();
+            denseDf = K.at<double>(0, 0) - cam.K.at<double>(0, 0);
+        }
+
+        int64 t0 = getTickCount();
+        double sparseRms = sparseCalibrateCamera(objectPoints, imagePoints, cam.imageSize, K, D,
+                                                 rvecs, tvecs, flags,
+                                                 TermCriteria(TermCriteria::COUNT+TermCriteria::EPS, 30, DBL_EPSILON),
+                                                 nthreads);
+        double sparseMs = (getTickCount() - t0)*1000./getTickFrequency();
+        double sparseDf = K.at<double>(0, 0) - cam.K.at<double>(0, 0);
+
+        if( denseMs >= 0 )
+            printf("%8d %12.1f %10.4f %10.3f", n, denseMs, denseRms, denseDf);
+        else
+            printf("%8d %12s %10s %10s", n, "-", "-", "-");
+        printf(" %12.1f %10.4f %10.3f\n", sparseMs, sparseRms, sparseDf);
+        if( n == maxViews )
+            break;
+    }
+    return 0;
+}
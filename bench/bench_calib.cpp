@@ -0,0 +1,583 @@
+// Benchmark of the calibration pipeline on synthetic boards.
+//
+// Renders stereo pairs of a chessboard, a symmetric and an asymmetric
+// circle grid seen by two cameras with known intrinsics and extrinsics,
+// runs them through StereoCalib (chessboard only, as that is all it
+// detects) and through the single camera findPattern/runCalibration path,
+// and reports throughput, per-stage latency percentiles and the error of
+// the estimated parameters against the ground truth. The chessboard pairs
+// also go through a CalibContext from memory, twice, to show what a
+// repeated calibration costs in a long-lived process. The scene is fully
+// determined by the command line, so runs of different builds with the
+// same arguments are comparable.
+
+#include "opencv2/core/core.hpp"
+#include "opencv2/calib3d/calib3d.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+#include "opencv2/highgui/highgui.hpp"
+
+#include "../calib_context.hpp"
+#include "../mapped_file.hpp"
+#include "../stereo_calib.hpp"
+#include "../metrics.hpp"
+#include "../xml/camera_calibration.hpp"
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+using namespace cv;
+using namespace std;
+
+static int print_help()
+{
+    cout << " Renders synthetic calibration boards with known camera parameters, calibrates\n"
+            " them and reports throughput, per-stage latencies and accuracy.\n" << endl;
+    cout << "Usage:\n ./bench_calib [-size WxH] [-n pairs] [-w board_width] [-h board_height]\n"
+            "   [-pattern all|chessboard|circles|acircles] [-t threads /*0 = one per core*/]\n"
+            "   [-coarse max_side_px] [-noise sigma /*gray levels*/] [-seed n] [-out work_dir]\n" << endl;
+    return 0;
+}
+
+enum { CHESSBOARD = 0, CIRCLES_GRID = 1, ASYMMETRIC_CIRCLES_GRID = 2 };
+static const char* patternNames[] = { "chessboard", "circles", "acircles" };
+
+struct Camera
+{
+    Mat K, D;
+    Mat normalized;   // CV_32FC2, undistorted normalized coordinates of every pixel
+};
+
+struct BenchScene
+{
+    Size imageSize;
+    Size boardSize;
+    int pattern;
+    Camera cam[2];
+    Mat R, T;                  // right camera from left camera: Xr = R*Xl + T
+    vector<Point3f> points;    // pattern features in board units
+    Rect_<float> extent;       // board including its quiet zone, board units
+    Mat texture;
+    Mat textureFromBoard;      // board units -> texture pixels
+};
+
+// Same layout as calcBoardCornerPositions() with unit squares.
+static void patternPoints(int pattern, Size boardSize, vector<Point3f>& points)
+{
+    points.clear();
+    for( int i = 0; i < boardSize.height; i++ )
+        for( int j = 0; j < boardSize.width; j++ )
+            points.push_back(pattern == ASYMMETRIC_CIRCLES_GRID ?
+                             Point3f((float)(2*j + i % 2), (float)i, 0) : Point3f((float)j, (float)i, 0));
+}
+
+// Draws the board with `ppu` texture pixels per board unit, black on white
+// with a white quiet zone of one unit around the features.
+static void renderTexture(BenchScene& scene, int ppu)
+{
+    const vector<Point3f>& pts = scene.points;
+    float x0 = pts[0].x, y0 = pts[0].y, x1 = x0, y1 = y0;
+    for( size_t i = 1; i < pts.size(); i++ )
+    {
+        x0 = std::min(x0, pts[i].x); x1 = std::max(x1, pts[i].x);
+        y0 = std::min(y0, pts[i].y); y1 = std::max(y1, pts[i].y);
+    }
+    // chessboard squares reach one unit beyond the inner corners
+    float border = scene.pattern == CHESSBOARD ? 2.f : 1.f;
+    scene.extent = Rect_<float>(x0 - border, y0 - border, x1 - x0 + 2*border, y1 - y0 + 2*border);
+
+    Rect_<float>& e = scene.extent;
+    scene.texture.create(cvRound(e.height*ppu), cvRound(e.width*ppu), CV_8U);
+    scene.texture.setTo(Scalar::all(255));
+    // texture pixel centers are at integer coordinates, so a board
+    // coordinate X falls on (X - e.x)*ppu - 0.5
+    double m[] = { (double)ppu, 0, -e.x*ppu - 0.5, 0, (double)ppu, -e.y*ppu - 0.5, 0, 0, 1 };
+    Mat(3, 3, CV_64F, m).copyTo(scene.textureFromBoard);
+
+    if( scene.pattern == CHESSBOARD )
+    {
+        for( int i = -1; i < scene.boardSize.height; i++ )
+            for( int j = -1; j < scene.boardSize.width; j++ )
+                if( ((i + j) & 1) == 0 )
+                {
+                    int x = cvRound((j - e.x)*ppu), y = cvRound((i - e.y)*ppu);
+                    rectangle(scene.texture, Rect(x, y, ppu, ppu), Scalar::all(0), FILLED);
+                }
+    }
+    else
+    {
+        const int shift = 4;
+        const float radius = 0.3f;
+        for( size_t i = 0; i < pts.size(); i++ )
+        {
+            Point center(cvRound(((pts[i].x - e.x)*ppu - 0.5)*(1 << shift)),
+                         cvRound(((pts[i].y - e.y)*ppu - 0.5)*(1 << shift)));
+            circle(scene.texture, center, cvRound(radius*ppu*(1 << shift)), Scalar::all(0),
+                   FILLED, LINE_AA, shift);
+        }
+    }
+}
+
+static void initCamera(Camera& cam, Size imageSize, double f, Point2d c, double k1, double k2)
+{
+    cam.K = (Mat_<double>(3, 3) << f, 0, c.x, 0, f, c.y, 0, 0, 1);
+    cam.D = (Mat_<double>(1, 5) << k1, k2, 0, 0, 0);
+
+    Mat pixels(imageSize, CV_32FC2);
+    for( int y = 0; y < imageSize.height; y++ )
+    {
+        Point2f* row = pixels.ptr<Point2f>(y);
+        for( int x = 0; x < imageSize.width; x++ )
+            row[x] = Point2f((float)x, (float)y);
+    }
+    undistortPoints(pixels.reshape(2, 1), cam.normalized, cam.K, cam.D);
+    cam.normalized = cam.normalized.reshape(2, imageSize.height);
+}
+
+static void initScene(BenchScene& scene, Size imageSize, Size boardSize, int pattern)
+{
+    scene.imageSize = imageSize;
+    scene.boardSize = boardSize;
+    scene.pattern = pattern;
+    patternPoints(pattern, boardSize, scene.points);
+    renderTexture(scene, 32);
+
+    // Both cameras share the focal length and have no tangential
+    // distortion, matching the model StereoCalib fits.
+    double f = imageSize.width*0.9;
+    Point2d c(imageSize.width*0.5 - 0.5, imageSize.height*0.5 - 0.5);
+    initCamera(scene.cam[0], imageSize, f, c + Point2d(imageSize.width*0.01, -imageSize.height*0.01), -0.08, 0.02);
+    initCamera(scene.cam[1], imageSize, f, c + Point2d(-imageSize.width*0.008, imageSize.height*0.006), -0.06, 0.015);
+
+    // The right camera sits a fifth of the working distance to the right,
+    // slightly toed in.
+    double distance = f*scene.extent.width/(imageSize.width*0.5);
+    Mat rvec = (Mat_<double>(3, 1) << 0.004, -0.03, 0.002);
+    Rodrigues(rvec, scene.R);
+    Mat center = (Mat_<double>(3, 1) << distance*0.2, distance*0.005, distance*0.01);
+    scene.T = -scene.R*center;
+}
+
+static bool inside(const vector<Point2f>& pts, Size size, float margin)
+{
+    for( size_t i = 0; i < pts.size(); i++ )
+        if( pts[i].x < margin || pts[i].y < margin ||
+            pts[i].x > size.width - 1 - margin || pts[i].y > size.height - 1 - margin )
+            return false;
+    return true;
+}
+
+// Picks a random board pose (board -> left camera) that keeps the whole
+// board, quiet zone included, inside both images.
+static void randomPose(const BenchScene& scene, RNG& rng, Mat& rvec, Mat& tvec)
+{
+    const Rect_<float>& e = scene.extent;
+    vector<Point3f> outline;
+    outline.push_back(Point3f(e.x, e.y, 0));
+    outline.push_back(Point3f(e.x + e.width, e.y, 0));
+    outline.push_back(Point3f(e.x + e.width, e.y + e.height, 0));
+    outline.push_back(Point3f(e.x, e.y + e.height, 0));
+    Point3d boardCenter(e.x + e.width*0.5, e.y + e.height*0.5, 0);
+
+    const Camera& cam0 = scene.cam[0];
+    double f = cam0.K.at<double>(0, 0);
+    double distance0 = f*e.width/(scene.imageSize.width*0.5);
+    double baseline = norm(scene.T);
+    const double deg = CV_PI/180;
+
+    for( int attempt = 0; ; attempt++ )
+    {
+        // tilts stay well below 90 degrees minus the half field of view, so
+        // every viewing ray meets the board plane in front of the camera
+        double scale = attempt < 1000 ? 1 : 0.5;
+        Mat r = (Mat_<double>(3, 1) << rng.uniform(-25., 25.)*deg*scale,
+                 rng.uniform(-25., 25.)*deg*scale, rng.uniform(-15., 15.)*deg*scale);
+        Mat Rb;
+        Rodrigues(r, Rb);
+        double z = distance0*rng.uniform(0.9, 1.25);
+        Mat c = (Mat_<double>(3, 1) << baseline*0.5 + rng.uniform(-0.1, 0.1)*z*scene.imageSize.width/f*scale,
+                 rng.uniform(-0.1, 0.1)*z*scene.imageSize.height/f*scale, z);
+        Mat t = c - Rb*Mat(boardCenter);
+
+        vector<Point2f> proj;
+        projectPoints(outline, r, t, scene.cam[0].K, scene.cam[0].D, proj);
+        if( !inside(proj, scene.imageSize, 4) )
+            continue;
+        Mat rR, rr, tr;
+        Rodrigues(scene.R, rR);
+        composeRT(r, t, rR, scene.T, rr, tr);
+        projectPoints(outline, rr, tr, scene.cam[1].K, scene.cam[1].D, proj);
+        if( !inside(proj, scene.imageSize, 4) )
+            continue;
+        rvec = r;
+        tvec = t;
+        return;
+    }
+}
+
+// Renders the board seen by one camera: every pixel's viewing ray is
+// intersected with the board plane through the inverse plane homography,
+// and the texture is sampled there. A slight blur and sensor noise make
+// the detectors work for their corners.
+static void renderView(const BenchScene& scene, int k, const Mat& rvec, const Mat& tvec,
+                       double noise, RNG& rng, Mat& view)
+{
+    Mat Rb;
+    Rodrigues(rvec, Rb);
+    Mat H(3, 3, CV_64F);
+    Rb.col(0).copyTo(H.col(0));
+    Rb.col(1).copyTo(H.col(1));
+    tvec.copyTo(H.col(2));
+    Mat textureFromNormalized = scene.textureFromBoard*H.inv();
+
+    Mat map;
+    perspectiveTransform(scene.cam[k].normalized, map, textureFromNormalized);
+    remap(scene.texture, view, map, Mat(), INTER_LINEAR, BORDER_CONSTANT, Scalar::all(128));
+    GaussianBlur(view, view, Size(0, 0), 0.7);
+    if( noise > 0 )
+    {
+        Mat n(view.size(), CV_16S);
+        rng.fill(n, RNG::NORMAL, 0, noise);
+        Mat v;
+        view.convertTo(v, CV_16S);
+        v += n;
+        v.convertTo(view, CV_8U);
+    }
+}
+
+static double percentile(const vector<double>& sorted, double p)
+{
+    if( sorted.empty() )
+        return 0;
+    int idx = (int)ceil(p/100*sorted.size()) - 1;
+    return sorted[std::max(0, std::min(idx, (int)sorted.size() - 1))];
+}
+
+static void printStages(const Metrics& metrics)
+{
+    vector<string> stages = metrics.stages();
+    printf("  %-24s %7s %10s %10s %10s %12s\n", "stage", "count", "p50 ms", "p90 ms", "p99 ms", "total ms");
+    for( size_t i = 0; i < stages.size(); i++ )
+    {
+        vector<double> s = metrics.samples(stages[i]);
+        if( s.empty() )
+            continue;
+        std::sort(s.begin(), s.end());
+        double total = 0;
+        for( size_t j = 0; j < s.size(); j++ )
+            total += s[j];
+        printf("  %-24s %7d %10.3f %10.3f %10.3f %12.3f\n", stages[i].c_str(), (int)s.size(),
+               percentile(s, 50), percentile(s, 90), percentile(s, 99), total);
+    }
+}
+
+static void printIntrinsicsError(const char* name, const Camera& truth, const Mat& K, const Mat& D)
+{
+    printf("  %s: f %+.3f px, cx %+.3f px, cy %+.3f px, k1 %+.5f, k2 %+.5f\n", name,
+           K.at<double>(0, 0) - truth.K.at<double>(0, 0),
+           K.at<double>(0, 2) - truth.K.at<double>(0, 2),
+           K.at<double>(1, 2) - truth.K.at<double>(1, 2),
+           D.at<double>(0) - truth.D.at<double>(0),
+           D.at<double>(1) - truth.D.at<double>(1));
+}
+
+static void runStereo(const BenchScene& scene, const vector<string>& files, const string& outDir,
+                      const StereoCalibOptions& baseOpts)
+{
+    Metrics metrics;
+    metrics.keepSamples(true);
+    StereoCalibOptions opts = baseOpts;
+    opts.batch = true;
+    opts.outputDir = outDir;
+    opts.metrics = &metrics;
+
+    StereoCalibResult result;
+    int64 t0 = getTickCount();
+    bool ok = StereoCalib(files, scene.boardSize, true, false, opts, &result);
+    double seconds = (getTickCount() - t0)/getTickFrequency();
+
+    printf("\nStereoCalib, %s: %d images in %.3f s, %.2f frames/s\n", patternNames[scene.pattern],
+           (int)files.size(), seconds, files.size()/seconds);
+    printStages(metrics);
+    if( !ok )
+    {
+        printf("  calibration failed\n");
+        return;
+    }
+    printf("  pairs used %d/%d, rms %.4f px, epipolar error %.4f px\n", result.npairs,
+           (int)files.size()/2, result.rms, result.epipolarError);
+    printIntrinsicsError("left ", scene.cam[0], result.cameraMatrix[0], result.distCoeffs[0]);
+    printIntrinsicsError("right", scene.cam[1], result.cameraMatrix[1], result.distCoeffs[1]);
+
+    Mat dR = result.R*scene.R.t(), dr;
+    Rodrigues(dR, dr);
+    printf("  R %.4f deg, T %.3f%% (|T| = %.3f board units)\n", norm(dr)*180/CV_PI,
+           norm(result.T - scene.T)/norm(scene.T)*100, norm(scene.T));
+}
+
+// All stages of CalibContext on the pairs in memory, run twice in the same
+// context; the second run reuses the buffers, the matchers and the maps.
+static void runContext(const BenchScene& scene, const vector<Mat>* views, const StereoCalibOptions& baseOpts)
+{
+    CalibContextOptions copts;
+    copts.nthreads = baseOpts.nthreads;
+    copts.coarseSize = baseOpts.coarseSize;
+    CalibContext ctx(copts);
+    for( int run = 0; run < 2; run++ )
+    {
+        int64 t0 = getTickCount();
+        ctx.reset(scene.boardSize);
+        int npairs = ctx.addPairs(views[0], views[1]);
+        int64 t1 = getTickCount();
+        bool ok = ctx.calibrate();
+        int64 t2 = getTickCount(), t3 = t2, t4 = t2;
+        Mat rect[2], disp;
+        if( ok )
+        {
+            ctx.rectify();
+            t3 = getTickCount();
+            ctx.remap(views[0][0], views[1][0], rect[0], rect[1]);
+            ctx.disparity(rect[0], rect[1], disp);
+            t4 = getTickCount();
+        }
+        double f = 1./getTickFrequency();
+        printf("\nCalibContext, %s run: detection %.3f s (%d/%d pairs), solve %.3f s, "
+               "rectification %.3f s, first disparity %.3f s\n", run == 0 ? "first" : "repeated",
+               (t1 - t0)*f, npairs, (int)views[0].size(), (t2 - t1)*f, (t3 - t2)*f, (t4 - t3)*f);
+        if( !ok )
+        {
+            printf("  calibration failed\n");
+            return;
+        }
+        const StereoCalibResult& result = ctx.result();
+        printf("  pairs used %d, rms %.4f px, epipolar error %.4f px\n", result.npairs,
+               result.rms, result.epipolarError);
+    }
+}
+
+static void runMono(const BenchScene& scene, const vector<string>& files)
+{
+    Metrics metrics;
+    metrics.keepSamples(true);
+
+    Settings s;
+    s.boardSize = scene.boardSize;
+    s.calibrationPattern = scene.pattern == CHESSBOARD ? Settings::CHESSBOARD :
+                           scene.pattern == CIRCLES_GRID ? Settings::CIRCLES_GRID :
+                           Settings::ASYMMETRIC_CIRCLES_GRID;
+    s.squareSize = 1.f;
+    s.flag = CALIB_FIX_ASPECT_RATIO | CALIB_ZERO_TANGENT_DIST;
+
+    vector<vector<Point2f> > imagePoints;
+    int64 t0 = getTickCount();
+    for( size_t i = 0; i < files.size(); i++ )
+    {
+        StageTimer loadTimer(&metrics, "load", (int)i);
+        Mat view = imread(files[i], IMREAD_COLOR);
+        loadTimer.stop();
+        vector<Point2f> pointBuf;
+        StageTimer detectTimer(&metrics, "findPattern", (int)i);
+        bool found = !view.empty() && findPattern(s, view, pointBuf);
+        detectTimer.stop();
+        if( found )
+            imagePoints.push_back(pointBuf);
+        else
+            metrics.reject("findPattern");
+    }
+    double seconds = (getTickCount() - t0)/getTickFrequency();
+
+    Mat cameraMatrix, distCoeffs;
+    vector<Mat> rvecs, tvecs;
+    vector<float> reprojErrs;
+    double totalAvgErr = 0;
+    bool ok = false;
+    Size imageSize = scene.imageSize;
+    if( imagePoints.size() >= 3 )
+    {
+        StageTimer calibTimer(&metrics, "runCalibration");
+        ok = runCalibration(s, imageSize, cameraMatrix, distCoeffs, imagePoints, rvecs, tvecs,
+                            reprojErrs, totalAvgErr);
+    }
+
+    printf("\nrunCalibration, %s: detected %d/%d images in %.3f s, %.2f frames/s\n",
+           patternNames[scene.pattern], (int)imagePoints.size(), (int)files.size(), seconds,
+           files.size()/seconds);
+    printStages(metrics);
+    if( !ok )
+    {
+        printf("  calibration failed\n");
+        return;
+    }
+    printf("  reprojection error %.4f px\n", totalAvgErr);
+    printIntrinsicsError("left ", scene.cam[0], cameraMatrix, distCoeffs);
+}
+
+int main(int argc, char** argv)
+{
+    Size imageSize(1280, 960), boardSize(9, 6);
+    int npairs = 20, seed = 1;
+    double noise = 2;
+    string outDir = "bench_data";
+    bool patterns[3] = { true, true, true };
+    StereoCalibOptions opts;
+
+    for( int i = 1; i < argc; i++ )
+    {
+        string arg = argv[i];
+        bool hasValue = i+1 < argc;
+        if( arg == "-size" )
+        {
+            if( !hasValue || sscanf(argv[++i], "%dx%d", &imageSize.width, &imageSize.height) != 2 ||
+                imageSize.width < 64 || imageSize.height < 64 )
+            {
+                cout << "invalid image size" << endl;
+                return print_help();
+            }
+        }
+        else if( arg == "-n" )
+        {
+            if( !hasValue || sscanf(argv[++i], "%d", &npairs) != 1 || npairs < 3 )
+            {
+                cout << "invalid frame count, at least 3 pairs are needed" << endl;
+                return print_help();
+            }
+        }
+        else if( arg == "-w" )
+        {
+            if( !hasValue || sscanf(argv[++i], "%d", &boardSize.width) != 1 || boardSize.width < 3 )
+            {
+                cout << "invalid board width" << endl;
+                return print_help();
+            }
+        }
+        else if( arg == "-h" )
+        {
+            if( !hasValue || sscanf(argv[++i], "%d", &boardSize.height) != 1 || boardSize.height < 3 )
+            {
+                cout << "invalid board height" << endl;
+                return print_help();
+            }
+        }
+        else if( arg == "-pattern" && hasValue )
+        {
+            string name = argv[++i];
+            for( int p = 0; p < 3; p++ )
+                patterns[p] = name == "all" || name == patternNames[p];
+            if( !patterns[0] && !patterns[1] && !patterns[2] )
+            {
+                cout << "invalid pattern " << name << endl;
+                return print_help();
+            }
+        }
+        else if( arg == "-t" )
+        {
+            if( !hasValue || sscanf(argv[++i], "%d", &opts.nthreads) != 1 || opts.nthreads < 0 )
+            {
+                cout << "invalid thread count" << endl;
+                return print_help();
+            }
+        }
+        else if( arg == "-coarse" )
+        {
+            if( !hasValue || sscanf(argv[++i], "%d", &opts.coarseSize) != 1 || opts.coarseSize < 0 )
+            {
+                cout << "invalid coarse level size" << endl;
+                return print_help();
+            }
+        }
+        else if( arg == "-noise" )
+        {
+            if( !hasValue || sscanf(argv[++i], "%lf", &noise) != 1 || noise < 0 )
+            {
+                cout << "invalid noise level" << endl;
+                return print_help();
+            }
+        }
+        else if( arg == "-seed" )
+        {
+            if( !hasValue || sscanf(argv[++i], "%d", &seed) != 1 )
+            {
+                cout << "invalid seed" << endl;
+                return print_help();
+            }
+        }
+        else if( arg == "-out" && hasValue )
+            outDir = argv[++i];
+        else
+        {
+            cout << "invalid option " << arg << endl;
+            return print_help();
+        }
+    }
+
+    if( !makeDirs(outDir) )
+    {
+        cout << "Error: can not create " << outDir << endl;
+        return -1;
+    }
+    printf("image size %dx%d, %d pairs, board %dx%d, noise %.1f, seed %d\n", imageSize.width,
+           imageSize.height, npairs, boardSize.width, boardSize.height, noise, seed);
+
+    for( int p = 0; p < 3; p++ )
+    {
+        if( !patterns[p] )
+            continue;
+        BenchScene scene;
+        initScene(scene, imageSize, boardSize, p);
+
+        // Images go through the file system like real captures do, so
+        // loading is part of the measurement. BMP keeps the encoder from
+        // dominating the setup time.
+        RNG rng((uint64)seed*3 + p);
+        vector<string> files, leftFiles;
+        vector<Mat> views[2];
+        int64 t0 = getTickCount();
+        for( int i = 0; i < npairs; i++ )
+        {
+            Mat rvec, tvec, view;
+            randomPose(scene, rng, rvec, tvec);
+            Mat rvecs[2] = { rvec, Mat() }, tvecs[2] = { tvec, Mat() };
+            Mat rR;
+            Rodrigues(scene.R, rR);
+            composeRT(rvec, tvec, rR, scene.T, rvecs[1], tvecs[1]);
+            for( int k = 0; k < 2; k++ )
+            {
+                renderView(scene, k, rvecs[k], tvecs[k], noise, rng, view);
+                string name = format("%s/%s_%s%03d.bmp", outDir.c_str(), patternNames[p],
+                                     k == 0 ? "left" : "right", i);
+                if( !imwrite(name, view) )
+                {
+                    cout << "Error: can not write " << name << endl;
+                    return -1;
+                }
+                files.push_back(name);
+                if( p == CHESSBOARD )
+                    views[k].push_back(view.clone());
+                if( k == 0 )
+                    leftFiles.push_back(name);
+            }
+        }
+        printf("\nrendered %d %s pairs in %.3f s\n", npairs, patternNames[p],
+               (getTickCount() - t0)/getTickFrequency());
+
+        // the list can be fed to stereo_calib directly
+        FileStorage fs(format("%s/%s_list.xml", outDir.c_str(), patternNames[p]), FileStorage::WRITE);
+        fs << "imagelist" << "[";
+        for( size_t i = 0; i < files.size(); i++ )
+            fs << files[i];
+        fs << "]";
+        fs.release();
+
+        if( p == CHESSBOARD )
+        {
+            runStereo(scene, files, outDir, opts);
+            runContext(scene, views, opts);
+        }
+        runMono(scene, leftFiles);
+    }
+    return 0;
+}
@@ -0,0 +1,240 @@
+// Benchmark of the tiled disparity engine.
+//
+// Matches a synthetic rectified pair (a textured background and a nearer
+// textured rectangle, both at known disparities) with DisparityEngine at
+// increasing thread counts and reports the time per frame, the speedup
+// over one thread, how many pixels differ from matching the whole frame
+// in one piece and how many matched pixels are more than a pixel off the
+// ground truth. OpenCV's own thread pool is limited to -cvthreads (one by
+// default) for the whole run, so with the default the scaling shown is
+// that of the engine.
+
+#include "opencv2/core/core.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include "../disparity.hpp"
+#include "../metrics.hpp"
+#include "../parallel.hpp"
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <iostream>
+#include <stdio.h>
+#include <math.h>
+
+using namespace cv;
+using namespace std;
+
+static int print_help()
+{
+    cout << " Matches a synthetic stereo pair with the tiled disparity engine at increasing\n"
+            " thread counts and reports time per frame, scaling and accuracy.\n" << endl;
+    cout << "Usage:\n ./bench_disparity [-size WxH] [-frames n] [-ndisp n /*multiple of 16*/]\n"
+            "   [-block n /*odd*/] [-sgbm] [-t max_threads /*0 = one per core*/]\n"
+            "   [-strips n /*0 = one per thread*/] [-cvthreads n] [-seed n]\n" << endl;
+    return 0;
+}
+
+struct Scene
+{
+    Mat left, right;
+    Mat truth;   // CV_32F, disparity of every left pixel
+};
+
+static void texture(RNG& rng, Size size, Mat& tex)
+{
+    tex.create(size, CV_8U);
+    rng.fill(tex, RNG::UNIFORM, 0, 256);
+    GaussianBlur(tex, tex, Size(), 1.0);
+}
+
+static void initScene(Scene& scene, Size imageSize, int ndisp, int seed)
+{
+    RNG rng(seed);
+    int db = ndisp/4, df = ndisp*3/4;
+    Mat background, foreground;
+    texture(rng, Size(imageSize.width + 2*db, imageSize.height), background);
+    Rect fg(imageSize.width/3, imageSize.height/4, imageSize.width/3, imageSize.height/2);
+    texture(rng, fg.size(), foreground);
+
+    // a texture column u shows up at u - d in the left and u - 2d in the
+    // right image, i.e. at disparity d
+    background(Rect(db, 0, imageSize.width, imageSize.height)).copyTo(scene.left);
+    background(Rect(2*db, 0, imageSize.width, imageSize.height)).copyTo(scene.right);
+    foreground.copyTo(scene.left(fg));
+    foreground.copyTo(scene.right(fg - Point(df, 0)));
+
+    scene.truth.create(imageSize, CV_32F);
+    scene.truth = Scalar(db);
+    scene.truth(fg) = Scalar(df);
+}
+
+static double percentile(const vector<double>& sorted, double p)
+{
+    if( sorted.empty() )
+        return 0;
+    int idx = (int)ceil(p/100*sorted.size()) - 1;
+    return sorted[std::max(0, std::min(idx, (int)sorted.size() - 1))];
+}
+
+// pixels with a disparity that is off the truth by more than a pixel,
+// among the pixels the matcher did not reject
+static double badPixels(const Mat& disp, const Mat& truth, int minDisparity)
+{
+    int matched = 0, bad = 0;
+    short invalid = (short)((minDisparity - 1)*16);
+    for( int y = 0; y < disp.rows; y++ )
+    {
+        const short* d = disp.ptr<short>(y);
+        const float* t = truth.ptr<float>(y);
+        for( int x = 0; x < disp.cols; x++ )
+        {
+            if( d[x] <= invalid )
+                continue;
+            matched++;
+            bad += fabs(d[x]/16. - t[x]) > 1;
+        }
+    }
+    return matched > 0 ? 100.*bad/matched : 0;
+}
+
+int main(int argc, char** argv)
+{
+    Size imageSize(1280, 720);
+    int nframes = 20, maxThreads = 0, nstrips = 0, cvThreads = 1, seed = 1;
+    DisparityParams dp;
+
+    for( int i = 1; i < argc; i++ )
+    {
+        string arg = argv[i];
+        bool hasValue = i+1 < argc;
+        if( arg == "-size" )
+        {
+            if( !hasValue || sscanf(argv[++i], "%dx%d", &imageSize.width, &imageSize.height) != 2 ||
+                imageSize.width < 256 || imageSize.height < 64 )
+            {
+                cout << "invalid image size" << endl;
+                return print_help();
+            }
+        }
+        else if( arg == "-frames" )
+        {
+            if( !hasValue || sscanf(argv[++i], "%d", &nframes) != 1 || nframes < 1 )
+            {
+                cout << "invalid frame count" << endl;
+                return print_help();
+            }
+        }
+        else if( arg == "-ndisp" )
+        {
+            if( !hasValue || sscanf(argv[++i], "%d", &dp.numDisparities) != 1 ||
+                dp.numDisparities <= 0 || dp.numDisparities % 16 != 0 )
+            {
+                cout << "invalid number of disparities" << endl;
+                return print_help();
+            }
+        }
+        else if( arg == "-block" )
+        {
+            if( !hasValue || sscanf(argv[++i], "%d", &dp.blockSize) != 1 ||
+                dp.blockSize < 5 || dp.blockSize % 2 == 0 )
+            {
+                cout << "invalid block size" << endl;
+                return print_help();
+            }
+        }
+        else if( arg == "-sgbm" )
+            dp.sgbm = true;
+        else if( arg == "-t" )
+        {
+            if( !hasValue || sscanf(argv[++i], "%d", &maxThreads) != 1 || maxThreads < 0 )
+            {
+                cout << "invalid thread count" << endl;
+                return print_help();
+            }
+        }
+        else if( arg == "-strips" )
+        {
+            if( !hasValue || sscanf(argv[++i], "%d", &nstrips) != 1 || nstrips < 0 )
+            {
+                cout << "invalid strip count" << endl;
+                return print_help();
+            }
+        }
+        else if( arg == "-cvthreads" )
+        {
+            if( !hasValue || sscanf(argv[++i], "%d", &cvThreads) != 1 )
+            {
+                cout << "invalid OpenCV thread count" << endl;
+                return print_help();
+            }
+        }
+        else if( arg == "-seed" )
+        {
+            if( !hasValue || sscanf(argv[++i], "%d", &seed) != 1 )
+            {
+                cout << "invalid seed" << endl;
+                return print_help();
+            }
+        }
+        else
+        {
+            cout << "invalid option " << arg << endl;
+            return print_help();
+        }
+    }
+    if( imageSize.width < 3*dp.numDisparities )
+    {
+        cout << "the image is too narrow for " << dp.numDisparities << " disparities" << endl;
+        return -1;
+    }
+
+    setNumThreads(cvThreads);
+    maxThreads = resolveThreadCount(maxThreads);
+
+    Scene scene;
+    initScene(scene, imageSize, dp.numDisparities, seed);
+
+    // the whole frame in one piece, for comparison
+    Mat reference;
+    DisparityEngine(dp, 1, 1).compute(scene.left, scene.right, reference);
+
+    printf("%s, %dx%d, %d disparities, block %d, %d frames\n", dp.sgbm ? "SGBM" : "BM",
+           imageSize.width, imageSize.height, dp.numDisparities, dp.blockSize, nframes);
+    printf("  %7s %6s %10s %10s %8s %8s %12s %8s\n", "threads", "strips", "p50 ms", "p90 ms",
+           "fps", "speedup", "differ px", "bad %");
+
+    vector<int> threadCounts;
+    for( int t = 1; t < maxThreads; t *= 2 )
+        threadCounts.push_back(t);
+    threadCounts.push_back(maxThreads);
+
+    double base = 0;
+    for( size_t i = 0; i < threadCounts.size(); i++ )
+    {
+        DisparityEngine engine(dp, threadCounts[i], nstrips);
+        Mat disp;
+        engine.compute(scene.left, scene.right, disp);   // warm up the buffers
+
+        Metrics metrics;
+        metrics.keepSamples(true);
+        for( int f = 0; f < nframes; f++ )
+        {
+            StageTimer timer(&metrics, "disparity", f);
+            engine.compute(scene.left, scene.right, disp);
+        }
+        vector<double> s = metrics.samples("disparity");
+        std::sort(s.begin(), s.end());
+        double p50 = percentile(s, 50);
+        if( i == 0 )
+            base = p50;
+
+        Mat diff;
+        compare(disp, reference, diff, CMP_NE);
+        printf("  %7d %6d %10.3f %10.3f %8.1f %7.2fx %12d %8.2f\n", engine.threads(),
+               engine.strips(imageSize.height), p50, percentile(s, 90), p50 > 0 ? 1000./p50 : 0.,
+               p50 > 0 ? base/p50 : 0., countNonZero(diff), badPixels(disp, scene.truth, dp.minDisparity));
+    }
+    return 0;
+}
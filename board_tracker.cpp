@@ -0,0 +1,132 @@
+#include "board_tracker.hpp"
+
+#include "opencv2/imgproc/imgproc.hpp"
+#include "opencv2/video/tracking.hpp"
+
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+using namespace cv;
+using namespace std;
+
+namespace
+{
+const Size FLOW_WINDOW(21, 21);
+const int FLOW_LEVELS = 3;
+// largest deviation of a corner from the midpoint of its neighbours, as a
+// fraction of their distance
+const double MAX_BEND = 0.15;
+
+double cross(Point2f a, Point2f b)
+{
+    return (double)a.x*b.y - (double)a.y*b.x;
+}
+}
+
+BoardTracker::BoardTracker(Size _boardSize) : boardSize(_boardSize)
+{
+}
+
+void BoardTracker::reset()
+{
+    prevCorners.clear();
+    prevPyramid.clear();
+}
+
+void BoardTracker::init(const Mat& gray, const vector<Point2f>& corners)
+{
+    if( (int)corners.size() != boardSize.area() )
+    {
+        reset();
+        return;
+    }
+    buildOpticalFlowPyramid(gray, prevPyramid, FLOW_WINDOW, FLOW_LEVELS);
+    prevCorners = corners;
+}
+
+bool BoardTracker::track(const Mat& gray, vector<Point2f>& corners)
+{
+    if( !tracking() )
+        return false;
+
+    buildOpticalFlowPyramid(gray, pyramid, FLOW_WINDOW, FLOW_LEVELS);
+    calcOpticalFlowPyrLK(prevPyramid, pyramid, prevCorners, corners, status, err, FLOW_WINDOW, FLOW_LEVELS,
+                         TermCriteria(TermCriteria::COUNT+TermCriteria::EPS, 20, 0.03));
+    bool ok = std::find(status.begin(), status.end(), (uchar)0) == status.end() &&
+              gridConsistent(corners, gray.size());
+    if( ok )
+    {
+        // a window that reaches past the neighbouring corners would pull
+        // the refinement towards them
+        int half = std::max(std::min(cvFloor(minSpacing(corners)*0.4), 11), 2);
+        cornerSubPix(gray, corners, Size(half, half), Size(-1,-1),
+                     TermCriteria(TermCriteria::COUNT+TermCriteria::EPS, 30, 0.1));
+        ok = gridConsistent(corners, gray.size());
+    }
+    if( !ok )
+    {
+        reset();
+        corners.clear();
+        return false;
+    }
+    prevPyramid.swap(pyramid);
+    prevCorners = corners;
+    return true;
+}
+
+double BoardTracker::minSpacing(const vector<Point2f>& corners) const
+{
+    double d = DBL_MAX;
+    int w = boardSize.width, h = boardSize.height;
+    for( int i = 0; i < h; i++ )
+        for( int j = 0; j < w; j++ )
+        {
+            Point2f p = corners[i*w + j];
+            if( j + 1 < w )
+                d = std::min(d, (double)norm(corners[i*w + j + 1] - p));
+            if( i + 1 < h )
+                d = std::min(d, (double)norm(corners[(i + 1)*w + j] - p));
+        }
+    return d;
+}
+
+bool BoardTracker::gridConsistent(const vector<Point2f>& corners, Size imageSize) const
+{
+    int w = boardSize.width, h = boardSize.height;
+    if( (int)corners.size() != w*h )
+        return false;
+    Rect_<float> frame(0.f, 0.f, (float)imageSize.width, (float)imageSize.height);
+    for( size_t k = 0; k < corners.size(); k++ )
+        if( !frame.contains(corners[k]) )
+            return false;
+
+    double orientation = 0;
+    for( int i = 0; i < h; i++ )
+        for( int j = 0; j < w; j++ )
+        {
+            Point2f p = corners[i*w + j];
+            if( j > 0 && j + 1 < w )
+            {
+                Point2f a = corners[i*w + j - 1], b = corners[i*w + j + 1];
+                if( norm((a + b)*0.5f - p) > MAX_BEND*norm(b - a) )
+                    return false;
+            }
+            if( i > 0 && i + 1 < h )
+            {
+                Point2f a = corners[(i - 1)*w + j], b = corners[(i + 1)*w + j];
+                if( norm((a + b)*0.5f - p) > MAX_BEND*norm(b - a) )
+                    return false;
+            }
+            // every cell has to turn the same way as the first one
+            if( i + 1 < h && j + 1 < w )
+            {
+                double c = cross(corners[i*w + j + 1] - p, corners[(i + 1)*w + j] - p);
+                if( orientation == 0 )
+                    orientation = c;
+                if( c*orientation <= 0 )
+                    return false;
+            }
+        }
+    return true;
+}
@@ -0,0 +1,45 @@
+#ifndef CALIB_BOARD_TRACKER_HPP
+#define CALIB_BOARD_TRACKER_HPP
+
+#include "opencv2/core/core.hpp"
+
+#include <vector>
+
+// Follows a detected chessboard through a live stream.
+//
+// Once the board has been found, the corners of the previous frame are
+// carried into the next one with pyramidal Lucas-Kanade optical flow and
+// refined with cornerSubPix, which costs a fraction of a fresh
+// findChessboardCorners. The tracked corners are accepted only if every
+// point was followed and they still form a regular grid: each inner corner
+// has to lie close to the midpoint of its neighbours along the row and the
+// column (lens distortion bends the grid only gently from one corner to
+// the next), and no cell may be folded over. Otherwise tracking is lost
+// and the caller detects from scratch. The corner order stays the one of
+// the detection that started the track.
+class BoardTracker
+{
+public:
+    explicit BoardTracker(cv::Size boardSize);
+
+    void reset();
+    bool tracking() const { return !prevCorners.empty(); }
+
+    // Starts a track from corners detected in the 8-bit grayscale frame.
+    void init(const cv::Mat& gray, const std::vector<cv::Point2f>& corners);
+    // Tracks the board into the next frame. Returns false, clears corners
+    // and stops tracking if the board was lost.
+    bool track(const cv::Mat& gray, std::vector<cv::Point2f>& corners);
+
+private:
+    bool gridConsistent(const std::vector<cv::Point2f>& corners, cv::Size imageSize) const;
+    double minSpacing(const std::vector<cv::Point2f>& corners) const;
+
+    cv::Size boardSize;
+    std::vector<cv::Mat> prevPyramid, pyramid;
+    std::vector<cv::Point2f> prevCorners;
+    std::vector<uchar> status;
+    std::vector<float> err;
+};
+
+#endif
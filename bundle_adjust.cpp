@@ -0,0 +1,372 @@
+#include "bundle_adjust.hpp"
+#include "parallel.hpp"
+
+#include "opencv2/calib3d/calib3d.hpp"
+
+#include <algorithm>
+#include <math.h>
+
+using namespace cv;
+using namespace std;
+
+namespace
+{
+// intrinsics: fx fy cx cy k1 k2 p1 p2 k3 k4 k5 k6
+enum { FX = 0, FY, CX, CY, DIST, NQ = 12 };
+
+typedef Vec<double, NQ> VecQ;
+typedef Matx<double, NQ, NQ> MatxQQ;
+typedef Matx<double, NQ, 6> MatxQ6;
+
+const int SUPPORTED_FLAGS = CALIB_USE_INTRINSIC_GUESS | CALIB_FIX_ASPECT_RATIO | CALIB_FIX_PRINCIPAL_POINT |
+    CALIB_FIX_FOCAL_LENGTH | CALIB_ZERO_TANGENT_DIST | CALIB_FIX_K1 | CALIB_FIX_K2 | CALIB_FIX_K3 |
+    CALIB_FIX_K4 | CALIB_FIX_K5 | CALIB_FIX_K6 | CALIB_RATIONAL_MODEL;
+
+// Which intrinsics are solved for. Free parameters are numbered 0..n-1 in
+// the order of the intrinsic vector; with a fixed aspect ratio fy follows
+// fx and has no parameter of its own.
+struct IntrinsicModel
+{
+    IntrinsicModel(int flags, const VecQ& q)
+    {
+        ndist = flags & CALIB_RATIONAL_MODEL ? 8 : 5;
+        aspect = flags & CALIB_FIX_ASPECT_RATIO ? q[FY]/q[FX] : 0;
+        bool fixed[NQ] = { false };
+        fixed[FX] = fixed[FY] = (flags & CALIB_FIX_FOCAL_LENGTH) != 0;
+        if( flags & CALIB_FIX_ASPECT_RATIO )
+            fixed[FY] = true;
+        fixed[CX] = fixed[CY] = (flags & CALIB_FIX_PRINCIPAL_POINT) != 0;
+        fixed[DIST] = (flags & CALIB_FIX_K1) != 0;
+        fixed[DIST+1] = (flags & CALIB_FIX_K2) != 0;
+        fixed[DIST+2] = fixed[DIST+3] = (flags & CALIB_ZERO_TANGENT_DIST) != 0;
+        fixed[DIST+4] = (flags & CALIB_FIX_K3) != 0;
+        fixed[DIST+5] = (flags & CALIB_FIX_K4) != 0 || ndist < 8;
+        fixed[DIST+6] = (flags & CALIB_FIX_K5) != 0 || ndist < 8;
+        fixed[DIST+7] = (flags & CALIB_FIX_K6) != 0 || ndist < 8;
+        for( int i = 0; i < NQ; i++ )
+            if( !fixed[i] )
+                params.push_back(i);
+    }
+
+    int size() const { return (int)params.size(); }
+
+    // derivatives of one residual by the free intrinsics, from a row of the
+    // projectPoints Jacobian (rotation, translation, f, c, distortion)
+    VecQ map(const double* Jrow) const
+    {
+        VecQ j;
+        for( int p = 0; p < size(); p++ )
+        {
+            int i = params[p];
+            j[p] = Jrow[6 + i];
+            if( i == FX && aspect != 0 )
+                j[p] += aspect*Jrow[6 + FY];
+        }
+        return j;
+    }
+
+    void update(VecQ& q, const VecQ& dq) const
+    {
+        for( int p = 0; p < size(); p++ )
+            q[params[p]] += dq[p];
+        if( aspect != 0 )
+            q[FY] = aspect*q[FX];
+    }
+
+    vector<int> params;
+    int ndist;
+    double aspect;   // fy/fx when fixed, 0 otherwise
+};
+
+Mat cameraMatrixOf(const VecQ& q)
+{
+    return (Mat_<double>(3, 3) << q[FX], 0, q[CX], 0, q[FY], q[CY], 0, 0, 1);
+}
+
+Mat distCoeffsOf(const VecQ& q, int ndist)
+{
+    Mat D(ndist, 1, CV_64F);
+    for( int i = 0; i < ndist; i++ )
+        D.at<double>(i) = q[DIST + i];
+    return D;
+}
+
+// Normal equation blocks of one view: V = Jv^t*Jv, gv = Jv^t*e for its
+// pose and W = Ji^t*Jv coupling it to the intrinsics.
+struct ViewBlock
+{
+    Matx66d V, Vinv;
+    Vec6d g;
+    MatxQ6 W;
+};
+
+class CameraAdjuster
+{
+public:
+    CameraAdjuster(const vector<vector<Point3f> >& _objectPoints, const vector<vector<Point2f> >& _imagePoints,
+                   const IntrinsicModel& _model, int _nthreads)
+        : objectPoints(_objectPoints), imagePoints(_imagePoints), model(_model),
+          nthreads(resolveThreadCount(_nthreads)), blocks(_objectPoints.size())
+    {
+        npoints = 0;
+        for( size_t v = 0; v < imagePoints.size(); v++ )
+            npoints += (int)imagePoints[v].size();
+    }
+
+    double run(VecQ& q, vector<Vec6d>& poses, TermCriteria criteria);
+
+private:
+    double cost(const VecQ& q, const vector<Vec6d>& poses) const;
+    void linearize(const VecQ& q, const vector<Vec6d>& poses, MatxQQ& U, VecQ& gq);
+    bool step(const MatxQQ& U, const VecQ& gq, double lambda, VecQ& dq, vector<Vec6d>& dposes);
+
+    const vector<vector<Point3f> >& objectPoints;
+    const vector<vector<Point2f> >& imagePoints;
+    const IntrinsicModel& model;
+    int nthreads, npoints;
+    vector<ViewBlock> blocks;
+};
+
+double CameraAdjuster::cost(const VecQ& q, const vector<Vec6d>& poses) const
+{
+    Mat K = cameraMatrixOf(q), D = distCoeffsOf(q, model.ndist);
+    vector<double> sums(nthreads, 0.);
+    parallelFor((int)poses.size(), nthreads, [&](int v, int tid)
+    {
+        vector<Point2f> proj;
+        const Vec6d& p = poses[v];
+        projectPoints(objectPoints[v], Matx31d(p[0], p[1], p[2]), Matx31d(p[3], p[4], p[5]), K, D, proj);
+        for( size_t j = 0; j < proj.size(); j++ )
+        {
+            Point2f d = imagePoints[v][j] - proj[j];
+            sums[tid] += (double)d.x*d.x + (double)d.y*d.y;
+        }
+    });
+    double s = 0;
+    for( int t = 0; t < nthreads; t++ )
+        s += sums[t];
+    return s;
+}
+
+void CameraAdjuster::linearize(const VecQ& q, const vector<Vec6d>& poses, MatxQQ& U, VecQ& gq)
+{
+    Mat K = cameraMatrixOf(q), D = distCoeffsOf(q, model.ndist);
+    vector<MatxQQ> tU(nthreads, MatxQQ::zeros());
+    vector<VecQ> tg(nthreads, VecQ::all(0));
+    parallelFor((int)poses.size(), nthreads, [&](int v, int tid)
+    {
+        ViewBlock& vb = blocks[v];
+        vb.V = Matx66d::zeros();
+        vb.g = Vec6d::all(0);
+        vb.W = MatxQ6::zeros();
+        vector<Point2f> proj;
+        Mat J;
+        const Vec6d& p = poses[v];
+        projectPoints(objectPoints[v], Matx31d(p[0], p[1], p[2]), Matx31d(p[3], p[4], p[5]), K, D, proj, J);
+        J.convertTo(J, CV_64F);
+        MatxQQ& Ut = tU[tid];
+        VecQ& gt = tg[tid];
+        for( size_t j = 0; j < proj.size(); j++ )
+            for( int c = 0; c < 2; c++ )
+            {
+                double e = c == 0 ? imagePoints[v][j].x - proj[j].x : imagePoints[v][j].y - proj[j].y;
+                const double* Jrow = J.ptr<double>((int)j*2 + c);
+                Vec6d jv(Jrow[0], Jrow[1], Jrow[2], Jrow[3], Jrow[4], Jrow[5]);
+                VecQ jq = model.map(Jrow);
+                vb.V += jv*jv.t();
+                vb.g += jv*e;
+                vb.W += jq*jv.t();
+                Ut += jq*jq.t();
+                gt += jq*e;
+            }
+    });
+    U = MatxQQ::zeros();
+    gq = VecQ::all(0);
+    for( int t = 0; t < nthreads; t++ )
+    {
+        U += tU[t];
+        gq += tg[t];
+    }
+}
+
+bool CameraAdjuster::step(const MatxQQ& U, const VecQ& gq, double lambda, VecQ& dq, vector<Vec6d>& dposes)
+{
+    // reduced intrinsic system S*dq = rhs, S = U - sum W*V^-1*W^t
+    vector<MatxQQ> tS(nthreads, MatxQQ::zeros());
+    vector<VecQ> trhs(nthreads, VecQ::all(0));
+    parallelFor((int)blocks.size(), nthreads, [&](int v, int tid)
+    {
+        ViewBlock& vb = blocks[v];
+        Matx66d V = vb.V;
+        for( int a = 0; a < 6; a++ )
+            V(a, a) *= 1 + lambda;
+        vb.Vinv = V.inv(DECOMP_CHOLESKY);
+        MatxQ6 WV = vb.W*vb.Vinv;
+        tS[tid] += WV*vb.W.t();
+        trhs[tid] += WV*vb.g;
+    });
+    MatxQQ S = U;
+    VecQ rhs = gq;
+    for( int t = 0; t < nthreads; t++ )
+    {
+        S -= tS[t];
+        rhs -= trhs[t];
+    }
+    int n = model.size();
+    for( int i = 0; i < NQ; i++ )
+    {
+        if( i < n )
+            S(i, i) += lambda*U(i, i);
+        else
+            S(i, i) = 1;   // unused slots
+    }
+    Mat dqm;
+    if( !solve(Mat(S), Mat(rhs), dqm, DECOMP_CHOLESKY) && !solve(Mat(S), Mat(rhs), dqm, DECOMP_SVD) )
+        return false;
+    dq = VecQ::all(0);
+    for( int i = 0; i < n; i++ )
+        dq[i] = dqm.at<double>(i);
+
+    // back-substitution of the poses
+    dposes.resize(blocks.size());
+    parallelFor((int)blocks.size(), nthreads, [&](int v, int)
+    {
+        const ViewBlock& vb = blocks[v];
+        dposes[v] = vb.Vinv*(vb.g - vb.W.t()*dq);
+    });
+    return true;
+}
+
+double CameraAdjuster::run(VecQ& q, vector<Vec6d>& poses, TermCriteria criteria)
+{
+    int maxIterations = criteria.type & TermCriteria::COUNT ? criteria.maxCount : 100;
+    double eps = criteria.type & TermCriteria::EPS ? criteria.epsilon : 0;
+    double err = cost(q, poses);
+    double lambda = 1e-3;
+    MatxQQ U;
+    VecQ gq, dq, newQ;
+    vector<Vec6d> dposes, newPoses;
+    for( int iter = 0; iter < maxIterations; iter++ )
+    {
+        linearize(q, poses, U, gq);
+        bool improved = false, converged = false;
+        // raise the damping until a step lowers the error
+        for( int attempt = 0; attempt < 10 && !improved; attempt++ )
+        {
+            if( step(U, gq, lambda, dq, dposes) )
+            {
+                newQ = q;
+                model.update(newQ, dq);
+                newPoses = poses;
+                double dnorm = dq.dot(dq), pnorm = 0;
+                for( int i = 0; i < model.size(); i++ )
+                    pnorm += q[model.params[i]]*q[model.params[i]];
+                for( size_t v = 0; v < poses.size(); v++ )
+                {
+                    newPoses[v] += dposes[v];
+                    dnorm += dposes[v].dot(dposes[v]);
+                    pnorm += poses[v].dot(poses[v]);
+                }
+                double newErr = cost(newQ, newPoses);
+                if( newErr < err )
+                {
+                    converged = sqrt(dnorm) <= eps*sqrt(pnorm);
+                    err = newErr;
+                    q = newQ;
+                    poses.swap(newPoses);
+                    lambda = std::max(lambda*0.1, 1e-12);
+                    improved = true;
+                    continue;
+                }
+            }
+            lambda *= 10;
+        }
+        if( !improved || converged )
+            break;
+    }
+    return npoints > 0 ? sqrt(err/npoints) : 0.;
+}
+}
+
+double sparseCalibrateCamera(const vector<vector<Point3f> >& objectPoints,
+                             const vector<vector<Point2f> >& imagePoints,
+                             Size imageSize, Mat& cameraMatrix, Mat& distCoeffs,
+                             vector<Mat>& rvecs, vector<Mat>& tvecs, int flags,
+                             TermCriteria criteria, int nthreads)
+{
+    int nviews = (int)objectPoints.size();
+    CV_Assert( nviews > 0 && (int)imagePoints.size() == nviews && (flags & ~SUPPORTED_FLAGS) == 0 );
+    for( int v = 0; v < nviews; v++ )
+        CV_Assert( objectPoints[v].size() == imagePoints[v].size() && objectPoints[v].size() >= 4 );
+
+    // STARTING POINT
+    VecQ q = VecQ::all(0);
+    Mat K;
+    if( flags & CALIB_USE_INTRINSIC_GUESS )
+    {
+        cameraMatrix.convertTo(K, CV_64F);
+        Mat D;
+        if( !distCoeffs.empty() )
+            distCoeffs.reshape(1, 1).convertTo(D, CV_64F);
+        for( int i = 0; i < (int)D.total() && i < 8; i++ )
+            q[DIST + i] = D.at<double>(i);
+    }
+    else
+    {
+        double aspect = 0;
+        if( (flags & CALIB_FIX_ASPECT_RATIO) && cameraMatrix.size() == Size(3, 3) )
+        {
+            Mat K0;
+            cameraMatrix.convertTo(K0, CV_64F);
+            aspect = K0.at<double>(0, 0)/K0.at<double>(1, 1);
+        }
+        K = initCameraMatrix2D(objectPoints, imagePoints, imageSize, aspect);
+    }
+    CV_Assert( K.size() == Size(3, 3) );
+    q[FX] = K.at<double>(0, 0);
+    q[FY] = K.at<double>(1, 1);
+    q[CX] = K.at<double>(0, 2);
+    q[CY] = K.at<double>(1, 2);
+    if( (flags & CALIB_FIX_PRINCIPAL_POINT) && !(flags & CALIB_USE_INTRINSIC_GUESS) )
+    {
+        q[CX] = (imageSize.width - 1)*0.5;
+        q[CY] = (imageSize.height - 1)*0.5;
+    }
+    if( flags & CALIB_ZERO_TANGENT_DIST )
+        q[DIST+2] = q[DIST+3] = 0;
+    IntrinsicModel model(flags, q);
+    for( int i = model.ndist; i < 8; i++ )
+        q[DIST + i] = 0;
+
+    // one pose per view from the starting intrinsics
+    vector<Vec6d> poses(nviews);
+    {
+        Mat K0 = cameraMatrixOf(q), D0 = distCoeffsOf(q, model.ndist);
+        parallelFor(nviews, nthreads, [&](int v, int)
+        {
+            Mat rvec, tvec;
+            solvePnP(objectPoints[v], imagePoints[v], K0, D0, rvec, tvec);
+            rvec.convertTo(rvec, CV_64F);
+            tvec.convertTo(tvec, CV_64F);
+            for( int i = 0; i < 3; i++ )
+            {
+                poses[v][i] = rvec.at<double>(i);
+                poses[v][i + 3] = tvec.at<double>(i);
+            }
+        });
+    }
+
+    CameraAdjuster adjuster(objectPoints, imagePoints, model, nthreads);
+    double rms = adjuster.run(q, poses, criteria);
+
+    cameraMatrix = cameraMatrixOf(q);
+    distCoeffs = distCoeffsOf(q, model.ndist);
+    rvecs.resize(nviews);
+    tvecs.resize(nviews);
+    for( int v = 0; v < nviews; v++ )
+    {
+        rvecs[v] = (Mat_<double>(3, 1) << poses[v][0], poses[v][1], poses[v][2]);
+        tvecs[v] = (Mat_<double>(3, 1) << poses[v][3], poses[v][4], poses[v][5]);
+    }
+    return rms;
+}
@@ -0,0 +1,36 @@
+#ifndef CALIB_BUNDLE_ADJUST_HPP
+#define CALIB_BUNDLE_ADJUST_HPP
+
+#include "opencv2/core/core.hpp"
+
+#include <float.h>
+#include <vector>
+
+// Single camera calibration with a sparse Levenberg-Marquardt solver, a
+// drop-in alternative to calibrateCamera for large view sets.
+//
+// The unknowns are the intrinsics, shared by all views, and one pose per
+// view. Each residual depends on the intrinsics and the pose of its own
+// view only, so the normal equations are an arrow: a small dense intrinsic
+// block, 6x6 pose blocks on the diagonal and the couplings between the
+// two. The pose blocks are eliminated view by view (Schur complement),
+// leaving a system of at most 12 unknowns; the poses follow by back
+// substitution. The Jacobian, the blocks and the reduction are computed in
+// parallel over the views, so an iteration costs time linear in the number
+// of views instead of the cubic growth of a dense solver.
+//
+// The arguments mean what they mean for calibrateCamera. Supported flags:
+// CALIB_USE_INTRINSIC_GUESS, CALIB_FIX_ASPECT_RATIO, CALIB_FIX_PRINCIPAL_POINT,
+// CALIB_FIX_FOCAL_LENGTH, CALIB_ZERO_TANGENT_DIST, CALIB_FIX_K1..CALIB_FIX_K6
+// and CALIB_RATIONAL_MODEL; distCoeffs has 8 entries with the rational
+// model and 5 otherwise. Without an intrinsic guess the camera matrix is
+// started with initCameraMatrix2D, so the board has to be planar. Returns
+// the RMS reprojection error.
+double sparseCalibrateCamera(const std::vector<std::vector<cv::Point3f> >& objectPoints,
+                             const std::vector<std::vector<cv::Point2f> >& imagePoints,
+                             cv::Size imageSize, cv::Mat& cameraMatrix, cv::Mat& distCoeffs,
+                             std::vector<cv::Mat>& rvecs, std::vector<cv::Mat>& tvecs, int flags = 0,
+                             cv::TermCriteria criteria = cv::TermCriteria(cv::TermCriteria::COUNT+cv::TermCriteria::EPS, 30, DBL_EPSILON),
+                             int nthreads = 0);
+
+#endif
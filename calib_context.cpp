@@ -0,0 +1,328 @@
+#include "calib_context.hpp"
+#include "calib_errors.hpp"
+#include "calib_file.hpp"
+#include "detect.hpp"
+#include "hash.hpp"
+#include "metrics.hpp"
+#include "parallel.hpp"
+
+#include "opencv2/imgproc/imgproc.hpp"
+
+using namespace cv;
+using namespace std;
+
+namespace
+{
+// largest upscale of a failed detection, as in StereoCalib
+const int MAX_SCALE = 2;
+
+// Corner cache key of an image in memory: its pixels and the detector
+// configuration, so the same frame handed in again is a hit.
+uint64_t imageKey(const Mat& image, uint64_t config)
+{
+    uint64_t h = hashValue(config, image.rows);
+    h = hashValue(h, image.cols);
+    h = hashValue(h, image.type());
+    for( int i = 0; i < image.rows; i++ )
+        h = hashBytes(image.ptr(i), image.cols*image.elemSize(), h);
+    return h;
+}
+
+void toGray(const Mat& image, Mat& gray, const Mat*& src)
+{
+    src = &image;
+    if( image.channels() != 1 )
+    {
+        cvtColor(image, gray, image.channels() == 4 ? COLOR_BGRA2GRAY : COLOR_BGR2GRAY);
+        src = &gray;
+    }
+}
+
+Mat cloneIfSet(const CalibFile& calib, const char* name, const Mat& current)
+{
+    Mat m = calib.get(name);
+    return m.empty() ? current : m.clone();
+}
+}
+
+CalibContext::CalibContext(const CalibContextOptions& _opts) :
+    opts(_opts), nworkers(resolveThreadCount(_opts.nthreads)), nextItem(0),
+    grayBuf(nworkers), cornerCache(_opts.cornerCacheDir), detectorConfig(0), mapsKey(0),
+    matcher(_opts.disparity, _opts.matchThreads, _opts.matchStrips)
+{
+}
+
+void CalibContext::reset(Size _boardSize)
+{
+    boardSize = _boardSize;
+    size = Size();
+    // same layout as the object points of StereoCalib
+    board.clear();
+    for( int i = 0; i < boardSize.height; i++ )
+        for( int j = 0; j < boardSize.width; j++ )
+            board.push_back(Point3f(i*opts.squareSize, j*opts.squareSize, 0));
+    for( int k = 0; k < 2; k++ )
+        imagePoints[k].clear();
+    detectorConfig = CornerCache::configKey(boardSize,
+        CALIB_CB_ADAPTIVE_THRESH | CALIB_CB_NORMALIZE_IMAGE, MAX_SCALE, opts.coarseSize);
+
+    res = StereoCalibResult();
+    keptPairs.clear();
+    solveRounds.clear();
+    for( int k = 0; k < 2; k++ )
+    {
+        rectR[k] = rectP[k] = Mat();
+        roi[k] = Rect();
+    }
+    disparityToDepth = Mat();
+}
+
+bool CalibContext::detectImage(const Mat& image, vector<Point2f>& corners, Mat& gray, int item)
+{
+    corners.clear();
+    if( image.empty() )
+        return false;
+    CV_Assert( boardSize.area() > 0 && image.depth() == CV_8U &&
+               (image.channels() == 1 || image.channels() == 3 || image.channels() == 4) );
+
+    uint64_t key = 0;
+    CachedCorners entry;
+    if( cornerCache.enabled() )
+    {
+        key = imageKey(image, detectorConfig);
+        if( cornerCache.load(key, entry) && entry.imageSize == image.size() )
+        {
+            corners.swap(entry.corners);
+            return entry.found;
+        }
+    }
+
+    const Mat* src;
+    toGray(image, gray, src);
+    // a prefilter verdict is not a detection result, so it is not cached
+    if( opts.prefilter && !mayContainBoard(*src, boardSize, PrefilterParams(), opts.metrics, item) )
+        return false;
+    bool found = opts.coarseSize > 0 ?
+        findBoardCornersPyramid(*src, boardSize, corners, opts.coarseSize, MAX_SCALE, opts.metrics, item) :
+        findBoardCorners(*src, boardSize, corners, MAX_SCALE, opts.metrics, item);
+    if( !found )
+        corners.clear();
+    if( cornerCache.enabled() )
+    {
+        entry.found = found;
+        entry.imageSize = image.size();
+        entry.corners = corners;
+        cornerCache.store(key, entry);
+    }
+    return found;
+}
+
+bool CalibContext::detect(const Mat& image, vector<Point2f>& corners)
+{
+    return detectImage(image, corners, grayBuf[0], nextItem++);
+}
+
+bool CalibContext::keepPair(Size leftSize, Size rightSize, vector<Point2f>* pairCorners)
+{
+    if( leftSize != rightSize || (size != Size() && leftSize != size) )
+    {
+        if( opts.metrics )
+            opts.metrics->reject("size");
+        return false;
+    }
+    size = leftSize;
+    for( int k = 0; k < 2; k++ )
+    {
+        imagePoints[k].push_back(vector<Point2f>());
+        imagePoints[k].back().swap(pairCorners[k]);
+    }
+    return true;
+}
+
+bool CalibContext::addPair(const Mat& left, const Mat& right)
+{
+    vector<Point2f> c[2];
+    int item = nextItem;
+    nextItem += 2;
+    // the right view is only looked at if the board is in the left one
+    if( !detectImage(left, c[0], grayBuf[0], item) || !detectImage(right, c[1], grayBuf[0], item + 1) )
+    {
+        if( opts.metrics )
+            opts.metrics->reject("detect");
+        return false;
+    }
+    return keepPair(left.size(), right.size(), c);
+}
+
+int CalibContext::addPairs(const vector<Mat>& left, const vector<Mat>& right, vector<uchar>* found)
+{
+    CV_Assert( left.size() == right.size() );
+    int n = (int)left.size(), item = nextItem;
+    nextItem += 2*n;
+    pairCorners.resize(2*n);
+    pairFound.assign(n, 0);
+    parallelFor(n, nworkers, [&](int p, int tid)
+    {
+        pairFound[p] = detectImage(left[p], pairCorners[p*2], grayBuf[tid], item + p*2) &&
+                       detectImage(right[p], pairCorners[p*2+1], grayBuf[tid], item + p*2 + 1);
+    });
+
+    // kept in input order, as if the pairs were added one by one
+    int nkept = 0;
+    if( found )
+        found->assign(n, 0);
+    for( int p = 0; p < n; p++ )
+    {
+        bool ok = pairFound[p] != 0;
+        if( !ok && opts.metrics )
+            opts.metrics->reject("detect");
+        ok = ok && keepPair(left[p].size(), right[p].size(), &pairCorners[p*2]);
+        if( ok && found )
+            (*found)[p] = 1;
+        nkept += ok;
+    }
+    return nkept;
+}
+
+bool CalibContext::calibrate()
+{
+    int n = pairs();
+    if( n < 2 )
+        return false;
+
+    // robustStereoCalibrate prunes its input, the collected pairs stay
+    solveObject.resize(n);
+    for( int k = 0; k < 2; k++ )
+        solveImage[k].resize(n);
+    for( int i = 0; i < n; i++ )
+    {
+        solveObject[i] = board;
+        for( int k = 0; k < 2; k++ )
+            solveImage[k][i] = imagePoints[k][i];
+    }
+
+    // with CALIB_USE_INTRINSIC_GUESS a repeated calibration starts from the last one
+    Mat cameraMatrix[2], distCoeffs[2];
+    bool warm = (opts.flags & CALIB_USE_INTRINSIC_GUESS) && calibrated() && res.imageSize == size;
+    for( int k = 0; k < 2; k++ )
+    {
+        cameraMatrix[k] = warm ? res.cameraMatrix[k].clone() : Mat::eye(3, 3, CV_64F);
+        if( warm )
+            distCoeffs[k] = res.distCoeffs[k].clone();
+    }
+    Mat R, T, E, F;
+    CalibErrors epipolar;
+    double rms = robustStereoCalibrate(solveObject, solveImage, cameraMatrix, distCoeffs, size,
+                                       R, T, E, F, opts.flags, opts.criteria, opts.outliers, keptPairs,
+                                       &solveRounds, &epipolar, opts.metrics, opts.nthreads);
+
+    res = StereoCalibResult();
+    res.npairs = (int)keptPairs.size();
+    res.imageSize = size;
+    res.rms = rms;
+    res.epipolarError = epipolar.total;
+    for( int k = 0; k < 2; k++ )
+    {
+        res.cameraMatrix[k] = cameraMatrix[k];
+        res.distCoeffs[k] = distCoeffs[k];
+        rectR[k] = rectP[k] = Mat();
+        roi[k] = Rect();
+    }
+    res.R = R;
+    res.T = T;
+    res.E = E;
+    res.F = F;
+    disparityToDepth = Mat();
+    return true;
+}
+
+void CalibContext::rectify()
+{
+    CV_Assert( calibrated() );
+    Size imageSize = res.imageSize;
+    StageTimer rectifyTimer(opts.metrics, "stereoRectify");
+    stereoRectify(res.cameraMatrix[0], res.distCoeffs[0], res.cameraMatrix[1], res.distCoeffs[1],
+                  imageSize, res.R, res.T, rectR[0], rectR[1], rectP[0], rectP[1], disparityToDepth,
+                  CALIB_ZERO_DISPARITY, 1, imageSize, &roi[0], &roi[1]);
+    rectifyTimer.stop();
+
+    uint64_t key = RectifyMaps::key(res.cameraMatrix, res.distCoeffs, rectR, rectP, imageSize);
+    if( rectifyMaps.empty() || key != mapsKey )
+    {
+        StageTimer mapTimer(opts.metrics, "initUndistortRectifyMap");
+        rectifyMaps.compute(res.cameraMatrix, res.distCoeffs, rectR, rectP, imageSize);
+        mapsKey = key;
+    }
+}
+
+void CalibContext::remap(const Mat& left, const Mat& right, Mat& rectLeft, Mat& rectRight)
+{
+    CV_Assert( !rectifyMaps.empty() && left.size() == rectifyMaps.size() && right.size() == rectifyMaps.size() );
+    const Mat* views[2] = { &left, &right };
+    Mat* rect[2] = { &rectLeft, &rectRight };
+    StageTimer timer(opts.metrics, "rectify");
+    for( int k = 0; k < 2; k++ )
+    {
+        const Mat* src;
+        toGray(*views[k], rectGray[k], src);
+        cv::remap(*src, *rect[k], rectifyMaps.map(k, 0), rectifyMaps.map(k, 1), INTER_LINEAR);
+    }
+}
+
+void CalibContext::disparity(const Mat& rectLeft, const Mat& rectRight, Mat& disp)
+{
+    StageTimer timer(opts.metrics, "disparity");
+    matcher.compute(rectLeft, rectRight, disp);
+}
+
+void CalibContext::write(CalibFile& calib) const
+{
+    CV_Assert( calibrated() );
+    calib.set("M1", res.cameraMatrix[0]);
+    calib.set("D1", res.distCoeffs[0]);
+    calib.set("M2", res.cameraMatrix[1]);
+    calib.set("D2", res.distCoeffs[1]);
+    calib.set("R", res.R);
+    calib.set("T", res.T);
+    if( !res.E.empty() )
+        calib.set("E", res.E);
+    if( !res.F.empty() )
+        calib.set("F", res.F);
+    calib.setSequence("imageSize", (Mat_<int>(1, 2) << res.imageSize.width, res.imageSize.height));
+    if( disparityToDepth.empty() )
+        return;
+    calib.set("R1", rectR[0]);
+    calib.set("R2", rectR[1]);
+    calib.set("P1", rectP[0]);
+    calib.set("P2", rectP[1]);
+    calib.set("Q", disparityToDepth);
+    calib.setSequence("validRoi1", (Mat_<int>(1, 4) << roi[0].x, roi[0].y, roi[0].width, roi[0].height));
+    calib.setSequence("validRoi2", (Mat_<int>(1, 4) << roi[1].x, roi[1].y, roi[1].width, roi[1].height));
+}
+
+bool CalibContext::read(const CalibFile& calib, Size imageSize)
+{
+    // copies, calib may only borrow a file mapping
+    res.cameraMatrix[0] = cloneIfSet(calib, "M1", res.cameraMatrix[0]);
+    res.distCoeffs[0] = cloneIfSet(calib, "D1", res.distCoeffs[0]);
+    res.cameraMatrix[1] = cloneIfSet(calib, "M2", res.cameraMatrix[1]);
+    res.distCoeffs[1] = cloneIfSet(calib, "D2", res.distCoeffs[1]);
+    res.R = cloneIfSet(calib, "R", res.R);
+    res.T = cloneIfSet(calib, "T", res.T);
+    res.E = cloneIfSet(calib, "E", res.E);
+    res.F = cloneIfSet(calib, "F", res.F);
+    Mat s = calib.get("imageSize");
+    if( imageSize.area() > 0 )
+        res.imageSize = imageSize;
+    else if( s.total() == 2 && s.type() == CV_32S )
+        res.imageSize = Size(s.at<int>(0), s.at<int>(1));
+
+    // the rectification follows from the new calibration on rectify()
+    for( int k = 0; k < 2; k++ )
+    {
+        rectR[k] = rectP[k] = Mat();
+        roi[k] = Rect();
+    }
+    disparityToDepth = Mat();
+    return calibrated();
+}
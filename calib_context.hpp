@@ -0,0 +1,160 @@
+#ifndef CALIB_CALIB_CONTEXT_HPP
+#define CALIB_CALIB_CONTEXT_HPP
+
+#include "opencv2/core/core.hpp"
+#include "opencv2/calib3d/calib3d.hpp"
+
+#include "corner_cache.hpp"
+#include "disparity.hpp"
+#include "rectify_maps.hpp"
+#include "robust_calib.hpp"
+#include "stereo_calib.hpp"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class CalibFile;
+class Metrics;
+
+// Settings of a CalibContext, fixed for its lifetime.
+struct CalibContextOptions
+{
+    CalibContextOptions() : nthreads(0), coarseSize(0), prefilter(false), squareSize(1.f),
+        flags(cv::CALIB_FIX_ASPECT_RATIO + cv::CALIB_ZERO_TANGENT_DIST + cv::CALIB_SAME_FOCAL_LENGTH +
+              cv::CALIB_RATIONAL_MODEL + cv::CALIB_FIX_K3 + cv::CALIB_FIX_K4 + cv::CALIB_FIX_K5),
+        criteria(cv::TermCriteria::COUNT+cv::TermCriteria::EPS, 100, 1e-5),
+        matchThreads(0), matchStrips(0), metrics(0) {}
+    int nthreads;          // detection and residual workers, 0 = one per core
+    int coarseSize;        // > 0: coarse-to-fine detection starting at this image size
+    bool prefilter;        // skip detection on blurred or board-less images (see mayContainBoard)
+    std::string cornerCacheDir; // persistent corner cache keyed by the pixels, empty = disabled
+    float squareSize;      // board square size, sets the unit of T
+    int flags;             // stereoCalibrate flags, by default the ones of StereoCalib
+    cv::TermCriteria criteria;
+    OutlierRejection outliers;  // pairs dropped and re-solved without (see robustStereoCalibrate)
+    DisparityParams disparity;
+    int matchThreads;      // disparity workers, 0 = one per core (see DisparityEngine on OpenCV's threads)
+    int matchStrips;       // disparity strips per frame, 0 = one per worker
+    Metrics* metrics;      // per-stage timings, may be null
+};
+
+// Stereo calibration as a library, for processes that calibrate, rectify
+// and match many times over their lifetime (capture services and the like).
+//
+// The context takes frames from memory and runs the stages of StereoCalib
+// one at a time: detection (addPair/addPairs), the robust solve
+// (calibrate), rectification (rectify, remap) and matching (disparity).
+// Everything that is expensive to set up lives as long as the context:
+// the per-worker gray conversion buffers of the detectors, the copies of
+// the corners the solver prunes, the disparity engine with its matchers,
+// the rectification maps (recomputed only when the calibration changes)
+// and the corner cache. reset() starts a new calibration and keeps all of
+// it.
+//
+// A calibration can also be taken from a file written by stereo_calib or
+// by write() (see read()), to rectify and match without solving.
+//
+// The context is not thread-safe; its stages parallelize internally.
+class CalibContext
+{
+public:
+    explicit CalibContext(const CalibContextOptions& opts = CalibContextOptions());
+
+    // Drops the collected pairs and the calibration and sets the board of
+    // the next calibration.
+    void reset(cv::Size boardSize);
+
+    // Detection of the board in one BGR or gray 8-bit image.
+    bool detect(const cv::Mat& image, std::vector<cv::Point2f>& corners);
+    // Detects the board in both views and keeps the pair for calibrate()
+    // if it is found in both and the size matches the earlier pairs.
+    bool addPair(const cv::Mat& left, const cv::Mat& right);
+    // Like addPair for many pairs, detected in parallel. found (if not
+    // null) receives per pair whether it was kept. Returns the number kept.
+    int addPairs(const std::vector<cv::Mat>& left, const std::vector<cv::Mat>& right,
+                 std::vector<uchar>* found = 0);
+    int pairs() const { return (int)imagePoints[0].size(); }
+    cv::Size imageSize() const { return size; }
+    const std::vector<std::vector<cv::Point2f> >& corners(int k) const { return imagePoints[k]; }
+
+    // Stereo calibration of the collected pairs with outlier rejection.
+    // Returns false if there are fewer than two pairs. The pairs stay
+    // collected, so more can be added and the calibration repeated.
+    bool calibrate();
+    bool calibrated() const
+    {
+        return !res.cameraMatrix[0].empty() && !res.cameraMatrix[1].empty() &&
+               !res.R.empty() && !res.T.empty() && res.imageSize.area() > 0;
+    }
+    // goodImageList is not used; kept() has the indices of the pairs the
+    // solution rests on.
+    const StereoCalibResult& result() const { return res; }
+    const std::vector<int>& kept() const { return keptPairs; }
+    const std::vector<StereoRound>& rounds() const { return solveRounds; }
+
+    // Bouguet rectification of the current calibration and its maps, for
+    // frames of the calibration image size. The maps are only recomputed
+    // if the calibration changed since the last call. Needs calibrate() or
+    // read() first.
+    void rectify();
+    const RectifyMaps& maps() const { return rectifyMaps; }
+    const cv::Mat& rectification(int k) const { return rectR[k]; }
+    const cv::Mat& projection(int k) const { return rectP[k]; }
+    const cv::Mat& Q() const { return disparityToDepth; }
+    cv::Rect validRoi(int k) const { return roi[k]; }
+    // Rectifies a pair (gray if the input is color) with the maps of rectify().
+    void remap(const cv::Mat& left, const cv::Mat& right, cv::Mat& rectLeft, cv::Mat& rectRight);
+
+    // Disparity of a rectified CV_8UC1 pair, see DisparityEngine.
+    void disparity(const cv::Mat& rectLeft, const cv::Mat& rectRight, cv::Mat& disp);
+
+    // The calibration under the keys of intrinsics.yml and extrinsics.yml
+    // (M1, D1, M2, D2, R, T, R1, R2, P1, P2, Q, validRoi1, validRoi2) plus
+    // E, F and imageSize; the rectification is included once rectify() has
+    // run. The values reference the context's matrices until saved.
+    void write(CalibFile& calib) const;
+    // Takes over the M1, D1, M2, D2, R, T, E and F found in calib, so an
+    // intrinsics and an extrinsics file can be read one after another.
+    // imageSize (empty = the imageSize key) is the calibration image size,
+    // which stereo_calib does not write. Returns calibrated().
+    bool read(const CalibFile& calib, cv::Size imageSize = cv::Size());
+
+private:
+    CalibContextOptions opts;
+    int nworkers;
+    cv::Size boardSize, size;
+    std::vector<cv::Point3f> board;
+    std::vector<std::vector<cv::Point2f> > imagePoints[2];
+    int nextItem;                // metrics item of the next detected image
+
+    // scratch buffers, reused from call to call
+    std::vector<cv::Mat> grayBuf;                        // per worker
+    std::vector<std::vector<cv::Point2f> > pairCorners;  // 2 per pair of addPairs
+    std::vector<uchar> pairFound;
+    std::vector<std::vector<cv::Point3f> > solveObject;  // what robustStereoCalibrate prunes
+    std::vector<std::vector<cv::Point2f> > solveImage[2];
+    cv::Mat rectGray[2];
+
+    CornerCache cornerCache;
+    uint64_t detectorConfig;
+
+    StereoCalibResult res;
+    std::vector<int> keptPairs;
+    std::vector<StereoRound> solveRounds;
+
+    cv::Mat rectR[2], rectP[2], disparityToDepth;
+    cv::Rect roi[2];
+    RectifyMaps rectifyMaps;
+    uint64_t mapsKey;
+
+    DisparityEngine matcher;
+
+    bool detectImage(const cv::Mat& image, std::vector<cv::Point2f>& corners, cv::Mat& gray, int item);
+    bool keepPair(cv::Size leftSize, cv::Size rightSize, std::vector<cv::Point2f>* pairCorners);
+
+    CalibContext(const CalibContext&);
+    CalibContext& operator=(const CalibContext&);
+};
+
+#endif
@@ -0,0 +1,262 @@
+#include "calib_errors.hpp"
+#include "parallel.hpp"
+
+#include "opencv2/calib3d/calib3d.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+using namespace cv;
+using namespace std;
+
+namespace
+{
+// points per task of the epipolar evaluation
+const int EPIPOLAR_CHUNK = 4096;
+
+template<typename Pt>
+int packOffsets(const vector<vector<Pt> >& views, vector<int>& offsets)
+{
+    offsets.resize(views.size() + 1);
+    offsets[0] = 0;
+    for( size_t v = 0; v < views.size(); v++ )
+        offsets[v + 1] = offsets[v] + (int)views[v].size();
+    return offsets.back();
+}
+
+struct Intrinsics
+{
+    float fx, fy, cx, cy, skew;
+    float k[8];   // k1 k2 p1 p2 k3 k4 k5 k6
+};
+
+// Projects n object points with pose (r, t) and measures the distance to
+// the image points. No branches and no calls in the loop body, so it
+// vectorizes once sqrt is free of errno (see CMakeLists.txt).
+void reprojectKernel(int n, const float* X, const float* Y, const float* Z,
+                     const float* u, const float* v, const float* r, const float* t,
+                     const Intrinsics& in, float* err)
+{
+    const float k1 = in.k[0], k2 = in.k[1], p1 = in.k[2], p2 = in.k[3];
+    const float k3 = in.k[4], k4 = in.k[5], k5 = in.k[6], k6 = in.k[7];
+    for( int i = 0; i < n; i++ )
+    {
+        float xc = r[0]*X[i] + r[1]*Y[i] + r[2]*Z[i] + t[0];
+        float yc = r[3]*X[i] + r[4]*Y[i] + r[5]*Z[i] + t[1];
+        float zc = r[6]*X[i] + r[7]*Y[i] + r[8]*Z[i] + t[2];
+        float iz = 1.f/zc;
+        float x = xc*iz, y = yc*iz;
+        float r2 = x*x + y*y, r4 = r2*r2, r6 = r4*r2;
+        float radial = (1.f + k1*r2 + k2*r4 + k3*r6)/(1.f + k4*r2 + k5*r4 + k6*r6);
+        float xd = x*radial + 2.f*p1*x*y + p2*(r2 + 2.f*x*x);
+        float yd = y*radial + p1*(r2 + 2.f*y*y) + 2.f*p2*x*y;
+        float du = in.fx*xd + in.skew*yd + in.cx - u[i];
+        float dv = in.fy*yd + in.cy - v[i];
+        err[i] = std::sqrt(du*du + dv*dv);
+    }
+}
+
+// Distance of each point from the epipolar line of its partner, summed
+// over both images.
+void epipolarKernel(int n, const float* x1, const float* y1, const float* x2, const float* y2,
+                    const float* F, float* err)
+{
+    for( int i = 0; i < n; i++ )
+    {
+        // line of point 1 in image 2 (F*p1) and of point 2 in image 1 (F^t*p2)
+        float a2 = F[0]*x1[i] + F[1]*y1[i] + F[2];
+        float b2 = F[3]*x1[i] + F[4]*y1[i] + F[5];
+        float c2 = F[6]*x1[i] + F[7]*y1[i] + F[8];
+        float a1 = F[0]*x2[i] + F[3]*y2[i] + F[6];
+        float b1 = F[1]*x2[i] + F[4]*y2[i] + F[7];
+        float c1 = F[2]*x2[i] + F[5]*y2[i] + F[8];
+        err[i] = std::fabs(a1*x1[i] + b1*y1[i] + c1)/std::max(std::sqrt(a1*a1 + b1*b1), FLT_EPSILON) +
+                 std::fabs(a2*x2[i] + b2*y2[i] + c2)/std::max(std::sqrt(a2*a2 + b2*b2), FLT_EPSILON);
+    }
+}
+
+// Splits interleaved points into x and y planes.
+void deinterleave(const Point2f* pts, int n, float* x, float* y)
+{
+    for( int i = 0; i < n; i++ )
+    {
+        x[i] = pts[i].x;
+        y[i] = pts[i].y;
+    }
+}
+
+void toFloats(const Mat& m, float* dst, int n)
+{
+    Mat m64;
+    m.convertTo(m64, CV_64F);
+    const double* p = m64.ptr<double>();
+    for( int i = 0; i < n; i++ )
+        dst[i] = (float)p[i];
+}
+}
+
+double reprojectionErrors(const vector<vector<Point3f> >& objectPoints,
+                          const vector<vector<Point2f> >& imagePoints,
+                          const vector<Mat>& rvecs, const vector<Mat>& tvecs,
+                          const Mat& cameraMatrix, const Mat& distCoeffs,
+                          CalibErrors& errors, int nthreads)
+{
+    int nviews = (int)imagePoints.size();
+    CV_Assert( (int)objectPoints.size() == nviews && (int)rvecs.size() >= nviews && (int)tvecs.size() >= nviews );
+    int npoints = packOffsets(imagePoints, errors.offsets);
+    errors.pointErrors.resize(npoints);
+    errors.viewErrors.resize(nviews);
+    errors.total = 0;
+
+    Intrinsics in;
+    Mat K;
+    cameraMatrix.convertTo(K, CV_64F);
+    in.fx = (float)K.at<double>(0, 0);
+    in.skew = (float)K.at<double>(0, 1);
+    in.cx = (float)K.at<double>(0, 2);
+    in.fy = (float)K.at<double>(1, 1);
+    in.cy = (float)K.at<double>(1, 2);
+    int ndist = (int)distCoeffs.total();
+    bool generic = ndist > 8;
+    std::fill(in.k, in.k + 8, 0.f);
+    if( !generic && ndist > 0 )
+        toFloats(distCoeffs.reshape(1, 1), in.k, ndist);
+
+    // planar copies of all points, filled by the view that owns them
+    vector<float> planes(npoints*5);
+    float *X = &planes[0], *Y = X + npoints, *Z = Y + npoints, *u = Z + npoints, *v = u + npoints;
+    vector<double> viewSq(nviews, 0.);
+
+    parallelFor(nviews, nthreads, [&](int view, int)
+    {
+        int o = errors.offsets[view], n = errors.offsets[view + 1] - o;
+        CV_Assert( (int)objectPoints[view].size() == n );
+        if( n == 0 )
+        {
+            errors.viewErrors[view] = 0;
+            return;
+        }
+        float* err = &errors.pointErrors[o];
+        if( generic )
+        {
+            vector<Point2f> projected;
+            projectPoints(Mat(objectPoints[view]), rvecs[view], tvecs[view], cameraMatrix, distCoeffs, projected);
+            for( int i = 0; i < n; i++ )
+                err[i] = (float)norm(projected[i] - imagePoints[view][i]);
+        }
+        else
+        {
+            const Point3f* op = &objectPoints[view][0];
+            const Point2f* ip = &imagePoints[view][0];
+            for( int i = 0; i < n; i++ )
+            {
+                X[o + i] = op[i].x;
+                Y[o + i] = op[i].y;
+                Z[o + i] = op[i].z;
+            }
+            deinterleave(ip, n, u + o, v + o);
+
+            Mat R;
+            Rodrigues(rvecs[view], R);
+            float r[9], t[3];
+            toFloats(R, r, 9);
+            toFloats(tvecs[view].reshape(1, 1), t, 3);
+            reprojectKernel(n, X + o, Y + o, Z + o, u + o, v + o, r, t, in, err);
+        }
+
+        double sq = 0;
+        for( int i = 0; i < n; i++ )
+            sq += (double)err[i]*err[i];
+        viewSq[view] = sq;
+        errors.viewErrors[view] = (float)std::sqrt(sq/n);
+    });
+
+    double sq = 0;
+    for( int view = 0; view < nviews; view++ )
+        sq += viewSq[view];
+    errors.total = npoints > 0 ? std::sqrt(sq/npoints) : 0.;
+    return errors.total;
+}
+
+void epipolarPointErrors(const Mat& points1, const Mat& points2, const Mat& F,
+                         vector<float>& pointErrors, int nthreads)
+{
+    CV_Assert( points1.type() == CV_32FC2 && points2.type() == CV_32FC2 &&
+               points1.isContinuous() && points2.isContinuous() && points1.total() == points2.total() );
+    int npoints = (int)points1.total();
+    pointErrors.resize(npoints);
+    if( npoints == 0 )
+        return;
+
+    float f[9];
+    toFloats(F.reshape(1, 1), f, 9);
+    const Point2f* p1 = points1.ptr<Point2f>();
+    const Point2f* p2 = points2.ptr<Point2f>();
+    int nchunks = (npoints + EPIPOLAR_CHUNK - 1)/EPIPOLAR_CHUNK;
+    vector<vector<float> > scratch(resolveThreadCount(nthreads));
+    parallelFor(nchunks, nthreads, [&](int c, int tid)
+    {
+        int a = c*EPIPOLAR_CHUNK, n = std::min(npoints - a, (int)EPIPOLAR_CHUNK);
+        vector<float>& planes = scratch[tid];
+        planes.resize(EPIPOLAR_CHUNK*4);
+        float *x1 = &planes[0], *y1 = x1 + EPIPOLAR_CHUNK, *x2 = y1 + EPIPOLAR_CHUNK, *y2 = x2 + EPIPOLAR_CHUNK;
+        deinterleave(p1 + a, n, x1, y1);
+        deinterleave(p2 + a, n, x2, y2);
+        epipolarKernel(n, x1, y1, x2, y2, f, &pointErrors[a]);
+    });
+}
+
+double epipolarErrors(const vector<vector<Point2f> >* imagePoints,
+                      const Mat* cameraMatrix, const Mat* distCoeffs, const Mat& F,
+                      CalibErrors& errors, int nthreads)
+{
+    int nviews = (int)imagePoints[0].size();
+    CV_Assert( (int)imagePoints[1].size() == nviews );
+    int npoints = packOffsets(imagePoints[0], errors.offsets);
+    errors.viewErrors.resize(nviews);
+    errors.total = 0;
+
+    // all points of a camera back to back, undistorted in place
+    Mat pts[2];
+    for( int k = 0; k < 2; k++ )
+    {
+        pts[k].create(1, std::max(npoints, 1), CV_32FC2);
+        for( int view = 0; view < nviews; view++ )
+        {
+            int o = errors.offsets[view], n = errors.offsets[view + 1] - o;
+            CV_Assert( (int)imagePoints[k][view].size() == n );
+            if( n > 0 )
+                Mat(imagePoints[k][view]).reshape(2, 1).copyTo(pts[k].colRange(o, o + n));
+        }
+    }
+    if( npoints == 0 )
+    {
+        errors.pointErrors.clear();
+        std::fill(errors.viewErrors.begin(), errors.viewErrors.end(), 0.f);
+        return 0;
+    }
+    int nchunks = (npoints + EPIPOLAR_CHUNK - 1)/EPIPOLAR_CHUNK;
+    parallelFor(nchunks*2, nthreads, [&](int task, int)
+    {
+        int k = task % 2, a = (task/2)*EPIPOLAR_CHUNK, b = std::min(a + EPIPOLAR_CHUNK, npoints);
+        Mat chunk = pts[k].colRange(a, b);
+        undistortPoints(chunk, chunk, cameraMatrix[k], distCoeffs[k], Mat(), cameraMatrix[k]);
+    });
+    epipolarPointErrors(pts[0].colRange(0, npoints), pts[1].colRange(0, npoints), F,
+                        errors.pointErrors, nthreads);
+
+    double sum = 0;
+    for( int view = 0; view < nviews; view++ )
+    {
+        int o = errors.offsets[view], n = errors.offsets[view + 1] - o;
+        double s = 0;
+        for( int i = 0; i < n; i++ )
+            s += errors.pointErrors[o + i];
+        errors.viewErrors[view] = n > 0 ? (float)(s/n) : 0.f;
+        sum += s;
+    }
+    errors.total = sum/npoints;
+    return errors.total;
+}
@@ -0,0 +1,53 @@
+#ifndef CALIB_CALIB_ERRORS_HPP
+#define CALIB_CALIB_ERRORS_HPP
+
+#include "opencv2/core/core.hpp"
+
+#include <vector>
+
+// Residuals of a calibration, per point and per view.
+//
+// The points of all views are packed into one contiguous buffer and
+// evaluated in one pass: chunks of it are handed to parallelFor workers,
+// and the per-point arithmetic runs over planar (structure of arrays)
+// float buffers in branch-free loops. The loops vectorize only if sqrt
+// need not set errno, so the build compiles calib_errors.cpp with
+// -fno-math-errno (/fp:fast with MSVC). Point i of view v is entry
+// offsets[v] + i of pointErrors.
+struct CalibErrors
+{
+    CalibErrors() : total(0) {}
+    std::vector<int> offsets;        // views() + 1 entries, offsets.back() = number of points
+    std::vector<float> pointErrors;
+    std::vector<float> viewErrors;
+    double total;
+
+    int views() const { return offsets.empty() ? 0 : (int)offsets.size() - 1; }
+};
+
+// Reprojection error of every point: the distance between the image point
+// and the object point projected with the view's pose and the intrinsics.
+// viewErrors and total are RMS values, as calibrateCamera reports them.
+// Returns total. Distortion models beyond the 8-coefficient rational one
+// are evaluated with projectPoints.
+double reprojectionErrors(const std::vector<std::vector<cv::Point3f> >& objectPoints,
+                          const std::vector<std::vector<cv::Point2f> >& imagePoints,
+                          const std::vector<cv::Mat>& rvecs, const std::vector<cv::Mat>& tvecs,
+                          const cv::Mat& cameraMatrix, const cv::Mat& distCoeffs,
+                          CalibErrors& errors, int nthreads = 0);
+
+// Epipolar error of every point pair: the distance of the left point from
+// the epipolar line of the right one plus the other way round, both in
+// undistorted pixel coordinates. viewErrors and total are means.
+// imagePoints, cameraMatrix and distCoeffs hold the left and right camera.
+// Returns total.
+double epipolarErrors(const std::vector<std::vector<cv::Point2f> >* imagePoints,
+                      const cv::Mat* cameraMatrix, const cv::Mat* distCoeffs, const cv::Mat& F,
+                      CalibErrors& errors, int nthreads = 0);
+
+// The same for points that are already undistorted, given as two CV_32FC2
+// arrays of equal length; fills pointErrors only.
+void epipolarPointErrors(const cv::Mat& points1, const cv::Mat& points2, const cv::Mat& F,
+                         std::vector<float>& pointErrors, int nthreads = 0);
+
+#endif
@@ -0,0 +1,419 @@
+#include "calib_file.hpp"
+#include "hash.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <iostream>
+
+using namespace cv;
+using namespace std;
+
+namespace
+{
+const char CALIB_FILE_MAGIC[8] = { 'C','A','L','B','F','I','L','E' };
+const uint32_t CALIB_FILE_VERSION = 2;
+const uint64_t CALIB_FILE_ALIGN = 64;
+
+struct CalibFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t entryCount;
+    uint32_t entrySize;
+    uint64_t fileSize;
+    uint64_t dataChecksum;   // of the directory and the arrays, see dataChecksum()
+    uint64_t reserved[2];
+    uint64_t checksum;       // of the header fields above
+};
+
+struct CalibFileEntry
+{
+    char name[CalibFile::MAX_NAME_LENGTH + 1];   // zero padded
+    int32_t kind;
+    int32_t type;
+    int32_t rows, cols;
+    uint64_t offset;         // from the start of the file, 0 for empty values
+    uint64_t size;
+};
+
+uint64_t headerChecksum(const CalibFileHeader& hdr)
+{
+    return hashBytes(&hdr, offsetof(CalibFileHeader, checksum));
+}
+
+// The directory followed by every array, padding left out.
+uint64_t dataChecksum(const CalibFileEntry* dir, int n, const unsigned char* base,
+                      const vector<const void*>* arrays = 0)
+{
+    uint64_t h = hashBytes(dir, n*sizeof(CalibFileEntry));
+    for( int i = 0; i < n; i++ )
+        if( dir[i].size > 0 )
+            h = hashBytes(arrays ? (*arrays)[i] : base + dir[i].offset, (size_t)dir[i].size, h);
+    return h;
+}
+
+uint64_t alignUp(uint64_t offset)
+{
+    return (offset + CALIB_FILE_ALIGN - 1)/CALIB_FILE_ALIGN*CALIB_FILE_ALIGN;
+}
+
+bool validType(int type)
+{
+    return type >= 0 && (type & ~CV_MAT_TYPE_MASK) == 0 && CV_MAT_DEPTH(type) <= CV_64F;
+}
+
+// A sequence of numbers as a 1xn row, CV_32S if all of them are integers.
+bool readSequence(const FileNode& node, Mat& values)
+{
+    bool integral = true;
+    FileNodeIterator it = node.begin(), it_end = node.end();
+    for( ; it != it_end; ++it )
+    {
+        if( !(*it).isInt() && !(*it).isReal() )
+            return false;
+        integral = integral && (*it).isInt();
+    }
+    values = Mat(1, (int)node.size(), integral ? CV_32S : CV_64F);
+    int i = 0;
+    for( it = node.begin(); it != it_end; ++it, i++ )
+    {
+        if( integral )
+            values.at<int>(0, i) = (int)*it;
+        else
+            values.at<double>(0, i) = (double)*it;
+    }
+    return true;
+}
+}
+
+bool isFileStoragePath(const string& path)
+{
+    string p = path;
+    for( size_t i = 0; i < p.size(); i++ )
+        p[i] = (char)tolower((unsigned char)p[i]);
+    if( p.size() > 3 && p.compare(p.size() - 3, 3, ".gz") == 0 )
+        p.erase(p.size() - 3);
+    size_t dot = p.find_last_of('.');
+    if( dot == string::npos || p.find_first_of("/\\", dot) != string::npos )
+        return false;
+    string ext = p.substr(dot + 1);
+    return ext == "yml" || ext == "yaml" || ext == "xml" || ext == "json";
+}
+
+void CalibFile::clear()
+{
+    // drop the values before their backing mapping goes away
+    entries.clear();
+    file.close();
+}
+
+int CalibFile::find(const string& name) const
+{
+    for( size_t i = 0; i < entries.size(); i++ )
+        if( entries[i].name == name )
+            return (int)i;
+    return -1;
+}
+
+void CalibFile::put(const string& name, Kind kind, const Mat& value)
+{
+    CV_Assert( !name.empty() && name.size() <= (size_t)MAX_NAME_LENGTH && value.dims <= 2 );
+    int i = find(name);
+    if( i < 0 )
+    {
+        i = (int)entries.size();
+        entries.push_back(Entry());
+        entries[i].name = name;
+    }
+    entries[i].kind = kind;
+    entries[i].value = value;
+}
+
+void CalibFile::set(const string& name, const Mat& m)
+{
+    put(name, MATRIX, m);
+}
+
+void CalibFile::setInt(const string& name, int value)
+{
+    put(name, INT, Mat(1, 1, CV_32S, Scalar(value)));
+}
+
+void CalibFile::setReal(const string& name, double value)
+{
+    put(name, REAL, Mat(1, 1, CV_64F, Scalar(value)));
+}
+
+void CalibFile::setString(const string& name, const string& value)
+{
+    Mat m;
+    if( !value.empty() )
+        Mat(1, (int)value.size(), CV_8U, (void*)value.data()).copyTo(m);
+    put(name, STRING, m);
+}
+
+void CalibFile::setSequence(const string& name, const Mat& values)
+{
+    CV_Assert( values.empty() || ((values.rows == 1 || values.cols == 1) &&
+               (values.type() == CV_32S || values.type() == CV_64F)) );
+    Mat row = values;
+    if( !row.empty() )
+        row = (row.isContinuous() ? row : row.clone()).reshape(1, 1);
+    put(name, SEQUENCE, row);
+}
+
+Mat CalibFile::get(const string& name) const
+{
+    int i = find(name);
+    return i < 0 ? Mat() : entries[i].value;
+}
+
+int CalibFile::getInt(const string& name, int defaultValue) const
+{
+    int i = find(name);
+    if( i < 0 || (entries[i].kind != INT && entries[i].kind != REAL) )
+        return defaultValue;
+    const Mat& v = entries[i].value;
+    return v.depth() == CV_32S ? v.at<int>(0, 0) : cvRound(v.at<double>(0, 0));
+}
+
+double CalibFile::getReal(const string& name, double defaultValue) const
+{
+    int i = find(name);
+    if( i < 0 || (entries[i].kind != INT && entries[i].kind != REAL) )
+        return defaultValue;
+    const Mat& v = entries[i].value;
+    return v.depth() == CV_32S ? (double)v.at<int>(0, 0) : v.at<double>(0, 0);
+}
+
+string CalibFile::getString(const string& name, const string& defaultValue) const
+{
+    int i = find(name);
+    if( i < 0 || entries[i].kind != STRING )
+        return defaultValue;
+    const Mat& v = entries[i].value;
+    return v.empty() ? string() : string((const char*)v.data, v.total());
+}
+
+bool CalibFile::load(const string& path, bool verify)
+{
+    clear();
+    if( !file.open(path) || file.size() < sizeof(CalibFileHeader) )
+    {
+        file.close();
+        return false;
+    }
+    CalibFileHeader hdr;
+    memcpy(&hdr, file.data(), sizeof(hdr));
+    uint64_t dataStart = sizeof(hdr) + (uint64_t)hdr.entryCount*sizeof(CalibFileEntry);
+    if( memcmp(hdr.magic, CALIB_FILE_MAGIC, sizeof(hdr.magic)) != 0 ||
+        hdr.version != CALIB_FILE_VERSION || hdr.headerSize != sizeof(hdr) ||
+        hdr.entrySize != sizeof(CalibFileEntry) || hdr.checksum != headerChecksum(hdr) ||
+        hdr.fileSize != file.size() || dataStart > hdr.fileSize )
+    {
+        file.close();
+        return false;
+    }
+
+    int n = (int)hdr.entryCount;
+    vector<CalibFileEntry> dir(n);
+    if( n > 0 )
+        memcpy(&dir[0], file.data() + sizeof(hdr), n*sizeof(CalibFileEntry));
+    bool ok = true;
+    for( int i = 0; i < n && ok; i++ )
+    {
+        const CalibFileEntry& e = dir[i];
+        ok = e.name[0] != '\0' && e.name[MAX_NAME_LENGTH] == '\0' &&
+             e.kind >= MATRIX && e.kind <= SEQUENCE && validType(e.type) &&
+             e.rows >= 0 && e.cols >= 0 &&
+             e.size == (uint64_t)e.rows*(uint64_t)e.cols*CV_ELEM_SIZE(e.type) &&
+             (e.size == 0 || (e.offset >= dataStart && e.offset <= hdr.fileSize &&
+                              e.size <= hdr.fileSize - e.offset));
+    }
+    if( ok && verify && n > 0 )
+        ok = dataChecksum(&dir[0], n, file.data()) == hdr.dataChecksum;
+    if( !ok )
+    {
+        file.close();
+        return false;
+    }
+
+    // the values only borrow the mapped pages
+    entries.resize(n);
+    for( int i = 0; i < n; i++ )
+    {
+        const CalibFileEntry& e = dir[i];
+        entries[i].name = e.name;
+        entries[i].kind = (Kind)e.kind;
+        if( e.size > 0 )
+            entries[i].value = Mat(e.rows, e.cols, e.type, (void*)(file.data() + e.offset));
+    }
+    return true;
+}
+
+bool CalibFile::save(const string& path) const
+{
+    int n = (int)entries.size();
+    vector<CalibFileEntry> dir(n);
+    vector<Mat> values(n);
+    vector<const void*> arrays(n);
+    uint64_t offset = sizeof(CalibFileHeader) + (uint64_t)n*sizeof(CalibFileEntry);
+    for( int i = 0; i < n; i++ )
+    {
+        const Entry& entry = entries[i];
+        CalibFileEntry& e = dir[i];
+        memset(&e, 0, sizeof(e));
+        memcpy(e.name, entry.name.c_str(), entry.name.size());
+        values[i] = entry.value.isContinuous() ? entry.value : entry.value.clone();
+        e.kind = entry.kind;
+        e.type = values[i].type();
+        e.rows = values[i].rows;
+        e.cols = values[i].cols;
+        e.size = (uint64_t)values[i].total()*values[i].elemSize();
+        if( e.size > 0 )
+        {
+            offset = alignUp(offset);
+            e.offset = offset;
+            offset += e.size;
+        }
+        arrays[i] = values[i].data;
+    }
+
+    CalibFileHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, CALIB_FILE_MAGIC, sizeof(hdr.magic));
+    hdr.version = CALIB_FILE_VERSION;
+    hdr.headerSize = sizeof(hdr);
+    hdr.entryCount = (uint32_t)n;
+    hdr.entrySize = sizeof(CalibFileEntry);
+    hdr.fileSize = offset;
+    hdr.dataChecksum = n > 0 ? dataChecksum(&dir[0], n, 0, &arrays) : 0;
+    hdr.checksum = headerChecksum(hdr);
+
+    static const unsigned char zeros[CALIB_FILE_ALIGN] = { 0 };
+    vector<FileChunk> chunks;
+    FileChunk c = { &hdr, sizeof(hdr) };
+    chunks.push_back(c);
+    if( n > 0 )
+    {
+        c.data = &dir[0];
+        c.size = n*sizeof(CalibFileEntry);
+        chunks.push_back(c);
+    }
+    uint64_t written = sizeof(CalibFileHeader) + (uint64_t)n*sizeof(CalibFileEntry);
+    for( int i = 0; i < n; i++ )
+    {
+        if( dir[i].size == 0 )
+            continue;
+        c.data = zeros;
+        c.size = (size_t)(dir[i].offset - written);
+        if( c.size > 0 )
+            chunks.push_back(c);
+        c.data = arrays[i];
+        c.size = (size_t)dir[i].size;
+        chunks.push_back(c);
+        written = dir[i].offset + dir[i].size;
+    }
+    return writeFileAtomic(path, &chunks[0], (int)chunks.size());
+}
+
+bool CalibFile::readFileStorage(const string& path)
+{
+    clear();
+    FileStorage fs;
+    try
+    {
+        if( !fs.open(path, FileStorage::READ) )
+            return false;
+    }
+    catch( const cv::Exception& )
+    {
+        return false;
+    }
+
+    FileNode root = fs.root();
+    FileNodeIterator it = root.begin(), it_end = root.end();
+    for( ; it != it_end; ++it )
+    {
+        FileNode node = *it;
+        string key = node.name();
+        Mat m;
+        if( key.empty() || key.size() > (size_t)MAX_NAME_LENGTH )
+            cout << "Warning: skipped " << key << " in " << path << ", the key is too long" << endl;
+        else if( node.isInt() )
+            setInt(key, (int)node);
+        else if( node.isReal() )
+            setReal(key, (double)node);
+        else if( node.isString() )
+            setString(key, (string)node);
+        else if( node.isMap() && !node["dt"].empty() && !node["data"].empty() )
+        {
+            node >> m;
+            set(key, m);
+        }
+        else if( node.isSeq() && readSequence(node, m) )
+            setSequence(key, m);
+        else
+            cout << "Warning: skipped " << key << " in " << path << ", not a matrix, number, string or number sequence" << endl;
+    }
+    return true;
+}
+
+bool CalibFile::writeFileStorage(const string& path) const
+{
+    FileStorage fs(path, FileStorage::WRITE);
+    if( !fs.isOpened() )
+        return false;
+    for( size_t i = 0; i < entries.size(); i++ )
+    {
+        const Entry& e = entries[i];
+        fs << e.name;
+        switch( e.kind )
+        {
+        case MATRIX:
+            fs << e.value;
+            break;
+        case INT:
+            fs << e.value.at<int>(0, 0);
+            break;
+        case REAL:
+            fs << e.value.at<double>(0, 0);
+            break;
+        case STRING:
+            fs << getString(e.name);
+            break;
+        case SEQUENCE:
+            fs << "[:";
+            for( int j = 0; j < (int)e.value.total(); j++ )
+            {
+                if( e.value.depth() == CV_32S )
+                    fs << e.value.at<int>(0, j);
+                else
+                    fs << e.value.at<double>(0, j);
+            }
+            fs << "]";
+            break;
+        }
+    }
+    return true;
+}
+
+bool CalibFile::open(const string& path)
+{
+    char magic[sizeof(CALIB_FILE_MAGIC)];
+    FILE* f = fopen(path.c_str(), "rb");
+    if( !f )
+    {
+        clear();
+        return false;
+    }
+    size_t n = fread(magic, 1, sizeof(magic), f);
+    fclose(f);
+    if( n == sizeof(magic) && memcmp(magic, CALIB_FILE_MAGIC, sizeof(magic)) == 0 )
+        return load(path);
+    return readFileStorage(path);
+}
@@ -0,0 +1,92 @@
+#ifndef CALIB_CALIB_FILE_HPP
+#define CALIB_CALIB_FILE_HPP
+
+#include "opencv2/core/core.hpp"
+#include "mapped_file.hpp"
+
+#include <string>
+#include <vector>
+
+// Named calibration values (M1, D1, R, T, Q, Camera_Matrix, Image_points,
+// nrOfFrames, ...) with a compact binary file format next to the YAML/XML
+// files written through FileStorage.
+//
+// The binary file is a 64-byte header, a directory of 64-byte entries
+// (name, kind, element type, rows, cols, offset, size) and the values as
+// raw arrays, each starting on a 64-byte boundary. The header holds a
+// format version, a checksum of itself and a checksum of the directory
+// and the arrays. load() memory-maps the file and the matrices point
+// straight into the mapping, so loading a calibration with megabytes of
+// image points costs one pass of checksumming instead of text parsing;
+// the matrices are read-only and valid while the CalibFile is not
+// reloaded or destroyed. Files are written to a temporary name and
+// renamed into place, like the rectification maps.
+//
+// readFileStorage()/writeFileStorage() convert from and to YAML/XML with
+// the same keys: top-level matrices, integers, reals, strings and numeric
+// sequences (Rect, Size) round-trip; nested maps and sequences of maps
+// are skipped with a message.
+class CalibFile
+{
+public:
+    enum Kind { MATRIX = 0, INT = 1, REAL = 2, STRING = 3, SEQUENCE = 4 };
+    // longest key the binary format can hold
+    enum { MAX_NAME_LENGTH = 31 };
+
+    CalibFile() {}
+
+    // Binary file; verify = false skips the data checksum (the header and
+    // the directory are always checked).
+    bool load(const std::string& path, bool verify = true);
+    bool save(const std::string& path) const;
+    bool readFileStorage(const std::string& path);
+    bool writeFileStorage(const std::string& path) const;
+    // Reads either format, told apart by the first bytes of the file.
+    bool open(const std::string& path);
+    void clear();
+
+    bool has(const std::string& name) const { return find(name) >= 0; }
+    // Empty if there is no such key. INT, REAL and SEQUENCE values are
+    // returned as 1x1 and 1xn matrices (CV_32S if integral, CV_64F).
+    cv::Mat get(const std::string& name) const;
+    int getInt(const std::string& name, int defaultValue = 0) const;
+    double getReal(const std::string& name, double defaultValue = 0) const;
+    std::string getString(const std::string& name, const std::string& defaultValue = std::string()) const;
+
+    // Adds or replaces a value. The matrix is referenced, not copied, until
+    // the file is saved.
+    void set(const std::string& name, const cv::Mat& m);
+    void setInt(const std::string& name, int value);
+    void setReal(const std::string& name, double value);
+    void setString(const std::string& name, const std::string& value);
+    // 1xn or nx1 single channel CV_32S or CV_64F matrix, written to YAML/XML
+    // as a flow sequence
+    void setSequence(const std::string& name, const cv::Mat& values);
+
+    int size() const { return (int)entries.size(); }
+    const std::string& name(int i) const { return entries[i].name; }
+    Kind kind(int i) const { return entries[i].kind; }
+    const cv::Mat& value(int i) const { return entries[i].value; }
+
+private:
+    struct Entry
+    {
+        std::string name;
+        Kind kind;
+        cv::Mat value;
+    };
+    std::vector<Entry> entries;
+    MappedFile file;
+
+    int find(const std::string& name) const;
+    void put(const std::string& name, Kind kind, const cv::Mat& value);
+
+    CalibFile(const CalibFile&);
+    CalibFile& operator=(const CalibFile&);
+};
+
+// True for the file names written through FileStorage: .yml, .yaml, .xml,
+// .json, optionally followed by .gz.
+bool isFileStoragePath(const std::string& path);
+
+#endif
@@ -0,0 +1,92 @@
+#include "opencv2/core/core.hpp"
+
+#include "../calib_file.hpp"
+
+#include <iostream>
+#include <string>
+#include <stdio.h>
+
+using namespace cv;
+using namespace std;
+
+static int print_help()
+{
+    cout << " Converts calibration results between YAML/XML (intrinsics.yml, extrinsics.yml,\n"
+            " the camera_calibration output, ...) and the binary calibration file.\n"
+            " The input format is detected from its contents; the output is YAML/XML\n"
+            " for *.yml, *.yaml, *.xml, *.json (optionally .gz) and binary otherwise.\n" << endl;
+    cout << "Usage:\n ./calib_convert [-list /*print the keys*/] input [output]\n" << endl;
+    return 0;
+}
+
+static const char* kindName(CalibFile::Kind kind)
+{
+    switch( kind )
+    {
+    case CalibFile::MATRIX: return "matrix";
+    case CalibFile::INT: return "int";
+    case CalibFile::REAL: return "real";
+    case CalibFile::STRING: return "string";
+    case CalibFile::SEQUENCE: return "sequence";
+    }
+    return "?";
+}
+
+int main(int argc, char** argv)
+{
+    string input, output;
+    bool list = false;
+
+    for( int i = 1; i < argc; i++ )
+    {
+        string arg = argv[i];
+        if( arg == "-list" )
+            list = true;
+        else if( arg == "--help" )
+            return print_help();
+        else if( arg[0] == '-' )
+        {
+            cout << "invalid option " << arg << endl;
+            return print_help();
+        }
+        else if( input.empty() )
+            input = arg;
+        else if( output.empty() )
+            output = arg;
+        else
+            return print_help();
+    }
+    if( input.empty() || (output.empty() && !list) )
+        return print_help();
+
+    CalibFile calib;
+    int64 t0 = getTickCount();
+    if( !calib.open(input) )
+    {
+        cout << "Error: can not read " << input << " (missing, damaged or of an unknown format)" << endl;
+        return -1;
+    }
+    double loadMs = (getTickCount() - t0)*1000./getTickFrequency();
+
+    if( list )
+    {
+        printf("%-32s %-9s %6s %6s %4s\n", "key", "kind", "rows", "cols", "cn");
+        for( int i = 0; i < calib.size(); i++ )
+        {
+            const Mat& v = calib.value(i);
+            printf("%-32s %-9s %6d %6d %4d\n", calib.name(i).c_str(), kindName(calib.kind(i)),
+                   v.rows, v.cols, v.empty() ? 0 : v.channels());
+        }
+        printf("%d keys read in %.2f ms\n", calib.size(), loadMs);
+    }
+
+    if( output.empty() )
+        return 0;
+    bool ok = isFileStoragePath(output) ? calib.writeFileStorage(output) : calib.save(output);
+    if( !ok )
+    {
+        cout << "Error: can not write " << output << endl;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,122 @@
+#include "corner_cache.hpp"
+#include "hash.hpp"
+#include "mapped_file.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#ifdef _WIN32
+# include <direct.h>
+#else
+# include <sys/stat.h>
+# include <sys/types.h>
+#endif
+
+using namespace cv;
+using namespace std;
+
+namespace
+{
+const char CORNER_CACHE_MAGIC[8] = { 'C','A','L','B','C','R','N','R' };
+const uint32_t CORNER_CACHE_VERSION = 2;
+
+struct CornerCacheHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t found;
+    uint64_t key;
+    int32_t imageWidth, imageHeight;
+    int32_t count;
+    int32_t reserved;
+    uint64_t checksum;   // of the corner data
+};
+}
+
+CornerCache::CornerCache(const string& _dir) : dir(_dir)
+{
+    if( dir.empty() )
+        return;
+#ifdef _WIN32
+    _mkdir(dir.c_str());
+#else
+    mkdir(dir.c_str(), 0777);
+#endif
+}
+
+uint64_t CornerCache::configKey(Size boardSize, int flags, int param1, int param2, int param3)
+{
+    uint64_t h = hashBytes(CORNER_CACHE_MAGIC, sizeof(CORNER_CACHE_MAGIC));
+    h = hashValue(h, boardSize.width);
+    h = hashValue(h, boardSize.height);
+    h = hashValue(h, flags);
+    h = hashValue(h, param1);
+    h = hashValue(h, param2);
+    return hashValue(h, param3);
+}
+
+bool CornerCache::fileKey(const string& filename, uint64_t config, uint64_t& key)
+{
+    MappedFile file(filename);
+    if( !file.isOpened() )
+        return false;
+    key = hashBytes(file.data(), file.size(), config);
+    return true;
+}
+
+string CornerCache::entryPath(uint64_t key) const
+{
+    char name[32];
+    sprintf(name, "%016llx.corners", (unsigned long long)key);
+    return dir + "/" + name;
+}
+
+bool CornerCache::load(uint64_t key, CachedCorners& entry) const
+{
+    if( !enabled() )
+        return false;
+    MappedFile file(entryPath(key));
+    if( !file.isOpened() || file.size() < sizeof(CornerCacheHeader) )
+        return false;
+
+    CornerCacheHeader hdr;
+    memcpy(&hdr, file.data(), sizeof(hdr));
+    size_t dataSize = (size_t)std::max(hdr.count, 0)*sizeof(Point2f);
+    if( memcmp(hdr.magic, CORNER_CACHE_MAGIC, sizeof(hdr.magic)) != 0 ||
+        hdr.version != CORNER_CACHE_VERSION || hdr.key != key || hdr.count < 0 ||
+        file.size() != sizeof(hdr) + dataSize )
+        return false;
+    const unsigned char* data = file.data() + sizeof(hdr);
+    if( hashBytes(data, dataSize) != hdr.checksum )
+        return false;
+
+    entry.found = hdr.found != 0;
+    entry.imageSize = Size(hdr.imageWidth, hdr.imageHeight);
+    entry.corners.resize(hdr.count);
+    if( dataSize > 0 )
+        memcpy(&entry.corners[0], data, dataSize);
+    return true;
+}
+
+bool CornerCache::store(uint64_t key, const CachedCorners& entry) const
+{
+    if( !enabled() )
+        return false;
+
+    CornerCacheHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, CORNER_CACHE_MAGIC, sizeof(hdr.magic));
+    hdr.version = CORNER_CACHE_VERSION;
+    hdr.found = entry.found ? 1 : 0;
+    hdr.key = key;
+    hdr.imageWidth = entry.imageSize.width;
+    hdr.imageHeight = entry.imageSize.height;
+    hdr.count = (int32_t)entry.corners.size();
+    size_t dataSize = entry.corners.size()*sizeof(Point2f);
+    hdr.checksum = hashBytes(entry.corners.empty() ? 0 : &entry.corners[0], dataSize);
+
+    FileChunk chunks[2] = { { &hdr, sizeof(hdr) },
+                            { entry.corners.empty() ? 0 : &entry.corners[0], dataSize } };
+    return writeFileAtomic(entryPath(key), chunks, 2);
+}
@@ -0,0 +1,52 @@
+#ifndef CALIB_CORNER_CACHE_HPP
+#define CALIB_CORNER_CACHE_HPP
+
+#include "opencv2/core/core.hpp"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Detection result of one image as stored in the corner cache.
+struct CachedCorners
+{
+    CachedCorners() : found(false) {}
+    bool found;
+    cv::Size imageSize;
+    std::vector<cv::Point2f> corners;
+};
+
+// Persistent cache of subpixel-refined board corners.
+//
+// Each entry is a small file <dir>/<key>.corners holding a fixed 48-byte
+// header followed by the corners as packed float32 (x, y) pairs, so it can
+// be memory-mapped and read in place. The key combines a hash of the image
+// file contents with a hash of everything that influences detection (board
+// size, flags, scales, ...), which makes renamed or copied images hit and
+// edited images miss. Entries are written to a private temporary file and
+// renamed into place, so concurrent runs sharing a directory never see a
+// partially written entry; a header or size mismatch is treated as a miss.
+// Failed detections are cached as well.
+class CornerCache
+{
+public:
+    CornerCache() {}
+    explicit CornerCache(const std::string& dir);
+
+    bool enabled() const { return !dir.empty(); }
+
+    // Hash of the detector configuration, to be passed to fileKey().
+    static uint64_t configKey(cv::Size boardSize, int flags, int param1 = 0, int param2 = 0, int param3 = 0);
+    // Hash of the file contents combined with the configuration hash.
+    // Returns false if the file can not be read.
+    static bool fileKey(const std::string& filename, uint64_t config, uint64_t& key);
+
+    bool load(uint64_t key, CachedCorners& entry) const;
+    bool store(uint64_t key, const CachedCorners& entry) const;
+
+private:
+    std::string entryPath(uint64_t key) const;
+    std::string dir;
+};
+
+#endif
@@ -0,0 +1,130 @@
+#include "detect.hpp"
+#include "metrics.hpp"
+
+#include "opencv2/calib3d/calib3d.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include <algorithm>
+
+using namespace cv;
+using namespace std;
+
+bool findBoardCorners(const Mat& img, Size boardSize, vector<Point2f>& corners, int maxScale,
+                      Metrics* metrics, int item)
+{
+    bool found = false;
+    for( int scale = 1; scale <= maxScale; scale++ )
+    {
+        StageTimer timer(metrics, "detect", item, scale);
+        Mat timg;
+        if( scale == 1 )
+            timg = img;
+        else
+            resize(img, timg, Size(), scale, scale);
+        found = findChessboardCorners(timg, boardSize, corners,
+            CALIB_CB_ADAPTIVE_THRESH | CALIB_CB_NORMALIZE_IMAGE);
+        if( found )
+        {
+            if( scale > 1 )
+            {
+                Mat cornersMat(corners);
+                cornersMat *= 1./scale;
+            }
+            break;
+        }
+    }
+    if( !found )
+        return false;
+
+    StageTimer timer(metrics, "cornerSubPix", item);
+    cornerSubPix(img, corners, Size(11,11), Size(-1,-1),
+                 TermCriteria(TermCriteria::COUNT+TermCriteria::EPS,
+                              30, 0.01));
+    return true;
+}
+
+bool findBoardCornersPyramid(const Mat& img, Size boardSize, vector<Point2f>& corners,
+                             int maxCoarseSize, int maxScale, Metrics* metrics, int item)
+{
+    if( maxCoarseSize <= 0 || std::max(img.cols, img.rows) <= maxCoarseSize )
+        return findBoardCorners(img, boardSize, corners, maxScale, metrics, item);
+
+    int levels = 0;
+    for( Size sz = img.size(); std::max(sz.width, sz.height) > maxCoarseSize; levels++ )
+        sz = Size((sz.width + 1)/2, (sz.height + 1)/2);
+
+    StageTimer detectTimer(metrics, "detect", item, 1./(1 << levels));
+    vector<Mat> pyramid(levels + 1);
+    pyramid[0] = img;
+    for( int level = 1; level <= levels; level++ )
+        pyrDown(pyramid[level-1], pyramid[level]);
+
+    if( !findChessboardCorners(pyramid[levels], boardSize, corners,
+            CALIB_CB_ADAPTIVE_THRESH | CALIB_CB_NORMALIZE_IMAGE | CALIB_CB_FAST_CHECK) )
+        return false;
+    detectTimer.stop();
+
+    // pixel (x, y) of a pyrDown level is pixel (2x, 2y) of the level above;
+    // a small window is enough on the intermediate levels because the
+    // mapped corners are already within a pixel or two of the true ones
+    StageTimer subpixTimer(metrics, "cornerSubPix", item);
+    Mat cornersMat(corners);
+    cornerSubPix(pyramid[levels], corners, Size(5,5), Size(-1,-1),
+                 TermCriteria(TermCriteria::COUNT+TermCriteria::EPS, 10, 0.05));
+    for( int level = levels - 1; level >= 0; level-- )
+    {
+        cornersMat *= 2.;
+        if( level > 0 )
+            cornerSubPix(pyramid[level], corners, Size(5,5), Size(-1,-1),
+                         TermCriteria(TermCriteria::COUNT+TermCriteria::EPS, 10, 0.05));
+    }
+
+    cornerSubPix(img, corners, Size(11,11), Size(-1,-1),
+                 TermCriteria(TermCriteria::COUNT+TermCriteria::EPS,
+                              30, 0.01));
+    return true;
+}
+
+bool mayContainBoard(const Mat& img, Size boardSize, const PrefilterParams& params,
+                     Metrics* metrics, int item)
+{
+    StageTimer timer(metrics, "prefilter", item);
+    Mat small;
+    int side = std::max(img.cols, img.rows);
+    if( params.maxSide > 0 && side > params.maxSide )
+    {
+        double scale = (double)params.maxSide/side;
+        resize(img, small, Size(), scale, scale, INTER_AREA);
+    }
+    else
+        small = img;
+
+    Mat lap;
+    Scalar mu, sigma;
+    Laplacian(small, lap, CV_16S);
+    meanStdDev(lap, mu, sigma);
+    bool ok = sigma[0]*sigma[0] >= params.minSharpness;
+
+    if( ok && boardSize.area() > 0 )
+    {
+        // dxy^2 - dxx*dyy is positive at saddle points; count its local
+        // maxima that stand out from flat, noisy areas
+        Mat f, dxx, dyy, dxy, saddle, peaks;
+        small.convertTo(f, CV_32F, 1./255);
+        GaussianBlur(f, f, Size(), 1.0);
+        Sobel(f, dxx, CV_32F, 2, 0);
+        Sobel(f, dyy, CV_32F, 0, 2);
+        Sobel(f, dxy, CV_32F, 1, 1);
+        saddle = dxy.mul(dxy) - dxx.mul(dyy);
+        double maxSaddle = 0;
+        minMaxLoc(saddle, 0, &maxSaddle);
+        dilate(saddle, peaks, getStructuringElement(MORPH_RECT, Size(5, 5)));
+        Mat isPeak = (saddle >= peaks) & (saddle > std::max(0.1*maxSaddle, 1e-4));
+        ok = countNonZero(isPeak) >= params.minSaddleRatio*boardSize.area();
+    }
+
+    timer.stop();
+    if( !ok && metrics )
+        metrics->reject("prefilter");
+    return ok;
+}
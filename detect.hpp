@@ -0,0 +1,53 @@
+#ifndef CALIB_DETECT_HPP
+#define CALIB_DETECT_HPP
+
+#include "opencv2/core/core.hpp"
+
+#include <vector>
+
+class Metrics;
+
+// Finds the inner corners of a chessboard in a grayscale image and refines
+// them to subpixel accuracy. If the board is not found at the original
+// resolution, the image is upscaled by 2..maxScale and the search repeated;
+// the returned corners are always in original image coordinates.
+// Each attempt is recorded as a "detect" event with its scale, and the
+// refinement as a "cornerSubPix" event, if metrics are given.
+bool findBoardCorners(const cv::Mat& gray, cv::Size boardSize,
+                      std::vector<cv::Point2f>& corners, int maxScale = 2,
+                      Metrics* metrics = 0, int item = -1);
+
+// Coarse-to-fine variant for high resolution sensors. The image is reduced
+// with pyrDown until its longer side is at most maxCoarseSize pixels, the
+// board is searched on that level only, and the corners are then carried
+// back up the pyramid with a cornerSubPix refinement on every level, the
+// last one at full resolution. A board missing on the coarse level is
+// reported as not found, so failed frames cost a fraction of a full-size
+// search. Images that are already small enough go through findBoardCorners.
+bool findBoardCornersPyramid(const cv::Mat& gray, cv::Size boardSize,
+                             std::vector<cv::Point2f>& corners, int maxCoarseSize = 1024,
+                             int maxScale = 2, Metrics* metrics = 0, int item = -1);
+
+// Thresholds of mayContainBoard().
+struct PrefilterParams
+{
+    PrefilterParams() : maxSide(640), minSharpness(15), minSaddleRatio(0.5) {}
+    int maxSide;           // the test runs on a copy reduced to at most this size;
+                           // board squares should stay 5 or more pixels wide there
+    double minSharpness;   // variance of the Laplacian of the reduced copy
+    double minSaddleRatio; // saddle points needed, as a fraction of the board corners
+};
+
+// Quick test whether detection is worth attempting on a grayscale frame.
+// On a reduced copy it checks that the frame is not blurred (variance of
+// the Laplacian) and, unless boardSize is empty, that it has at least as
+// many saddle points (where the Hessian determinant is negative, as at
+// every inner chessboard corner) as a fraction of the board corners. It
+// costs a small fraction of a failed findChessboardCorners, which is what
+// most board-less or smeared frames end in. Recorded as a "prefilter"
+// event, rejections are counted against "prefilter".
+bool mayContainBoard(const cv::Mat& gray, cv::Size boardSize,
+                     const PrefilterParams& params = PrefilterParams(),
+                     Metrics* metrics = 0, int item = -1);
+
+#endif
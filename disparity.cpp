@@ -0,0 +1,155 @@
+#include "disparity.hpp"
+#include "parallel.hpp"
+
+#include "opencv2/calib3d/calib3d.hpp"
+
+#include <algorithm>
+
+using namespace cv;
+using namespace std;
+
+struct DisparityEngine::Worker
+{
+    explicit Worker(const DisparityParams& p);
+    void match(const Mat& left, const Mat& right, Mat& disp);
+
+#if CV_MAJOR_VERSION >= 3
+    Ptr<StereoMatcher> matcher;
+#else
+    bool sgbm;
+    StereoBM bm;
+    StereoSGBM sgbmMatcher;
+#endif
+    Mat strip;
+};
+
+// The speckle filter is left to the engine, see compute().
+DisparityEngine::Worker::Worker(const DisparityParams& p)
+{
+    int P1 = p.P1 > 0 ? p.P1 : 8*p.blockSize*p.blockSize;
+    int P2 = p.P2 > 0 ? p.P2 : 32*p.blockSize*p.blockSize;
+#if CV_MAJOR_VERSION >= 3
+    if( p.sgbm )
+        matcher = StereoSGBM::create(p.minDisparity, p.numDisparities, p.blockSize, P1, P2,
+                                     p.disp12MaxDiff, p.preFilterCap, p.uniquenessRatio, 0, 0);
+    else
+    {
+        Ptr<StereoBM> bm = StereoBM::create(p.numDisparities, p.blockSize);
+        bm->setPreFilterSize(p.preFilterSize);
+        bm->setPreFilterCap(p.preFilterCap);
+        bm->setMinDisparity(p.minDisparity);
+        bm->setTextureThreshold(p.textureThreshold);
+        bm->setUniquenessRatio(p.uniquenessRatio);
+        bm->setDisp12MaxDiff(p.disp12MaxDiff);
+        bm->setSpeckleWindowSize(0);
+        matcher = bm;
+    }
+#else
+    sgbm = p.sgbm;
+    if( sgbm )
+        sgbmMatcher = StereoSGBM(p.minDisparity, p.numDisparities, p.blockSize, P1, P2,
+                                 p.disp12MaxDiff, p.preFilterCap, p.uniquenessRatio, 0, 0);
+    else
+    {
+        bm.init(StereoBM::BASIC_PRESET, p.numDisparities, p.blockSize);
+        bm.state->preFilterSize = p.preFilterSize;
+        bm.state->preFilterCap = p.preFilterCap;
+        bm.state->minDisparity = p.minDisparity;
+        bm.state->textureThreshold = p.textureThreshold;
+        bm.state->uniquenessRatio = p.uniquenessRatio;
+        bm.state->disp12MaxDiff = p.disp12MaxDiff;
+        bm.state->speckleWindowSize = 0;
+    }
+#endif
+}
+
+void DisparityEngine::Worker::match(const Mat& left, const Mat& right, Mat& disp)
+{
+#if CV_MAJOR_VERSION >= 3
+    matcher->compute(left, right, disp);
+#else
+    if( sgbm )
+        sgbmMatcher(left, right, disp);
+    else
+        bm(left, right, disp, CV_16S);
+#endif
+}
+
+DisparityEngine::DisparityEngine() : nstrips(0)
+{
+    configure(DisparityParams());
+}
+
+DisparityEngine::DisparityEngine(const DisparityParams& params, int nthreads, int _nstrips) : nstrips(0)
+{
+    configure(params, nthreads, _nstrips);
+}
+
+DisparityEngine::~DisparityEngine()
+{
+    for( size_t t = 0; t < workers.size(); t++ )
+        delete workers[t];
+}
+
+void DisparityEngine::configure(const DisparityParams& params, int nthreads, int _nstrips)
+{
+    CV_Assert( params.numDisparities > 0 && params.numDisparities % 16 == 0 &&
+               params.blockSize > 0 && params.blockSize % 2 == 1 );
+    for( size_t t = 0; t < workers.size(); t++ )
+        delete workers[t];
+    workers.clear();
+
+    prm = params;
+    nstrips = _nstrips;
+    nthreads = resolveThreadCount(nthreads);
+    for( int t = 0; t < nthreads; t++ )
+        workers.push_back(new Worker(prm));
+    if( pool.size() != nthreads )
+        pool.reset(nthreads);
+}
+
+int DisparityEngine::overlap() const
+{
+    if( prm.overlap >= 0 )
+        return prm.overlap;
+    // SGBM has no exact overlap (see the class comment); a band of rows
+    // well beyond the window keeps the seams quiet
+    if( prm.sgbm )
+        return std::max(prm.blockSize/2 + 1, 32);
+    // the window sees blockSize/2 rows each way, the prefilter behind it
+    // another preFilterSize/2 (the Sobel prefilter of OpenCV 3 just one)
+    return prm.blockSize/2 + std::max(prm.preFilterSize/2, 1);
+}
+
+int DisparityEngine::strips(int rows) const
+{
+    int n = nstrips > 0 ? nstrips : threads();
+    // strips much thinner than their overlap mostly match shared rows
+    int minRows = std::max(2*overlap(), 16);
+    return std::max(std::min(n, rows/minRows), 1);
+}
+
+void DisparityEngine::compute(const Mat& left, const Mat& right, Mat& disp)
+{
+    CV_Assert( left.type() == CV_8UC1 && right.type() == CV_8UC1 && left.size() == right.size() );
+    int rows = left.rows, n = strips(rows), ov = overlap();
+
+    disp.create(left.size(), CV_16S);
+    if( n == 1 )
+        workers[0]->match(left, right, disp);
+    else
+    {
+        pool.run(n, [&](int s, int tid)
+        {
+            int y0 = (int)((int64)rows*s/n), y1 = (int)((int64)rows*(s + 1)/n);
+            int a = std::max(y0 - ov, 0), b = std::min(y1 + ov, rows);
+            Worker& w = *workers[tid];
+            w.match(left.rowRange(a, b), right.rowRange(a, b), w.strip);
+            w.strip.rowRange(y0 - a, y1 - a).copyTo(disp.rowRange(y0, y1));
+        });
+    }
+
+    if( prm.speckleWindowSize > 0 )
+        filterSpeckles(disp, (prm.minDisparity - 1)*16, prm.speckleWindowSize,
+                       prm.speckleRange*16, speckleBuf);
+}
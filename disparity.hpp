@@ -0,0 +1,87 @@
+#ifndef CALIB_DISPARITY_HPP
+#define CALIB_DISPARITY_HPP
+
+#include "opencv2/core/core.hpp"
+#include "parallel.hpp"
+
+#include <vector>
+
+struct DisparityParams
+{
+    DisparityParams() : sgbm(false), minDisparity(0), numDisparities(64), blockSize(15),
+        preFilterSize(9), preFilterCap(31), textureThreshold(10), uniquenessRatio(15),
+        speckleWindowSize(0), speckleRange(2), disp12MaxDiff(-1), P1(0), P2(0), overlap(-1) {}
+    bool sgbm;               // StereoSGBM instead of StereoBM
+    int minDisparity;
+    int numDisparities;      // multiple of 16
+    int blockSize;           // odd; BM needs at least 5
+    int preFilterSize;       // BM only, odd
+    int preFilterCap;
+    int textureThreshold;    // BM only
+    int uniquenessRatio;
+    int speckleWindowSize;   // 0 = no speckle filter
+    int speckleRange;        // largest disparity step inside a speckle, in pixels
+    int disp12MaxDiff;       // < 0 = no left-right check
+    int P1, P2;              // SGBM smoothness penalties, 0 = 8 and 32 * blockSize^2
+    int overlap;             // rows shared by neighbouring strips, < 0 = automatic
+};
+
+// Block matching on a thread pool.
+//
+// The engine keeps its worker threads (see ThreadPool) from frame to
+// frame; compute() wakes them and matches on the calling thread as well.
+//
+// The rectified pair is cut into horizontal strips that overlap by enough
+// rows for the matching window (and BM's prefilter) to see the same pixels
+// it would see in the whole frame; the strips are matched in parallel and
+// the inner rows of each are stitched into the result. Every worker owns
+// its matcher, whose cost buffers are reused from frame to frame, and its
+// strip buffer, so a warm engine allocates nothing. The speckle filter
+// finds connected regions across strip borders, so it runs once on the
+// stitched result instead of per strip.
+//
+// For BM the tiled result is identical to matching the whole frame. SGBM
+// aggregates costs along paths that cross the whole image, so its strips
+// only see the overlap of their neighbours and the seams can differ
+// slightly; raise overlap if that shows.
+//
+// OpenCV parallelizes BM and SGBM internally as well. With several
+// workers, limit OpenCV's pool once when the program starts
+// (cv::setNumThreads(1), as the tools do) so that the two pools do not
+// share the same cores; the engine leaves the setting alone because it
+// applies to the whole process.
+//
+// compute() may not be called from two threads at once.
+class DisparityEngine
+{
+public:
+    DisparityEngine();
+    // nthreads <= 0: one per core; nstrips <= 0: one per thread
+    explicit DisparityEngine(const DisparityParams& params, int nthreads = 0, int nstrips = 0);
+    ~DisparityEngine();
+
+    void configure(const DisparityParams& params, int nthreads = 0, int nstrips = 0);
+
+    // left, right: rectified CV_8UC1 images of the same size;
+    // disp: CV_16SC1, disparity * 16, (minDisparity - 1) * 16 where unknown
+    void compute(const cv::Mat& left, const cv::Mat& right, cv::Mat& disp);
+
+    const DisparityParams& params() const { return prm; }
+    int threads() const { return (int)workers.size(); }
+    int strips(int rows) const;
+    int overlap() const;
+
+private:
+    struct Worker;
+
+    DisparityParams prm;
+    int nstrips;
+    std::vector<Worker*> workers;
+    ThreadPool pool;
+    cv::Mat speckleBuf;
+
+    DisparityEngine(const DisparityEngine&);
+    DisparityEngine& operator=(const DisparityEngine&);
+};
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef CALIB_FRAME_QUEUE_HPP
+#define CALIB_FRAME_QUEUE_HPP
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+// Bounded FIFO that hands items from one pipeline stage to the next.
+//
+// A producer either waits for room (push) or, when it must not fall
+// behind a live source, evicts the oldest queued item (pushDropOldest) and
+// gets it back to recycle. close() wakes every waiting thread; afterwards
+// pushes fail and pops drain what is left, then fail.
+template<typename T>
+class BoundedQueue
+{
+public:
+    // outcome of pushDropOldest
+    enum PushResult { PUSHED = 0, EVICTED = 1, CLOSED = 2 };
+
+    explicit BoundedQueue(size_t _capacity) : capacity(_capacity > 0 ? _capacity : 1), closed(false) {}
+
+    bool push(const T& item)
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        notFull.wait(lock, [&]() { return closed || items.size() < capacity; });
+        if( closed )
+            return false;
+        items.push_back(item);
+        notEmpty.notify_one();
+        return true;
+    }
+
+    // Never blocks. Returns EVICTED if the queue was full and the oldest
+    // item was moved to `dropped` to make room. On a closed queue the item
+    // itself comes back through `dropped` and the result is CLOSED, which
+    // is a shutdown rather than a drop.
+    PushResult pushDropOldest(const T& item, T& dropped)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if( closed )
+        {
+            dropped = item;
+            return CLOSED;
+        }
+        bool full = items.size() >= capacity;
+        if( full )
+        {
+            dropped = items.front();
+            items.pop_front();
+        }
+        items.push_back(item);
+        notEmpty.notify_one();
+        return full ? EVICTED : PUSHED;
+    }
+
+    bool pop(T& item)
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        notEmpty.wait(lock, [&]() { return closed || !items.empty(); });
+        if( items.empty() )
+            return false;
+        item = items.front();
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        closed = true;
+        notFull.notify_all();
+        notEmpty.notify_all();
+    }
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        return items.size();
+    }
+
+private:
+    std::deque<T> items;
+    size_t capacity;
+    bool closed;
+    mutable std::mutex mtx;
+    std::condition_variable notFull, notEmpty;
+
+    BoundedQueue(const BoundedQueue&);
+    BoundedQueue& operator=(const BoundedQueue&);
+};
+
+#endif
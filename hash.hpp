@@ -0,0 +1,48 @@
+#ifndef CALIB_HASH_HPP
+#define CALIB_HASH_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// 64-bit hash used for cache keys and file checksums. The input is
+// consumed eight bytes at a time (the tail byte by byte, FNV-1a style);
+// every word goes through a multiply-xorshift round before it is folded
+// into the state, so a change in any bit reaches all bits of the state,
+// and the result is passed through a final avalanche step. This keeps
+// hashing a multi-megabyte image file well below the cost of decoding it.
+// It is not a cryptographic hash.
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ULL)
+{
+    const uint64_t prime = 1099511628211ULL;
+    const unsigned char* p = (const unsigned char*)data;
+    uint64_t h = seed;
+    size_t i = 0;
+    for( ; i + 8 <= size; i += 8 )
+    {
+        uint64_t w;
+        memcpy(&w, p + i, 8);
+        w *= 0x87c37b91114253d5ULL;
+        w ^= w >> 31;
+        w *= 0x4cf5ad432745937fULL;
+        h ^= w;
+        h = ((h << 27) | (h >> 37))*5 + 0x52dce729;
+    }
+    for( ; i < size; i++ )
+        h = (h ^ p[i])*prime;
+    h ^= (uint64_t)size;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// Mixes a plain value (board size, flags, ...) into a running hash.
+template<typename T> inline uint64_t hashValue(uint64_t h, const T& value)
+{
+    return hashBytes(&value, sizeof(value), h);
+}
+
+#endif
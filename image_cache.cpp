@@ -0,0 +1,87 @@
+#include "image_cache.hpp"
+
+using namespace cv;
+using namespace std;
+
+static size_t imageBytes(const Mat& img)
+{
+    return img.total()*img.elemSize();
+}
+
+ImageCache::ImageCache(size_t budgetBytes)
+    : budget(budgetBytes), used(0), nhits(0), nmisses(0)
+{
+}
+
+void ImageCache::put(const string& key, const Mat& img)
+{
+    size_t sz = imageBytes(img);
+    std::lock_guard<std::mutex> lock(mtx);
+
+    map<string, EntryList::iterator>::iterator it = index.find(key);
+    if( it != index.end() )
+    {
+        used -= imageBytes(it->second->second);
+        entries.erase(it->second);
+        index.erase(it);
+    }
+    if( img.empty() || sz > budget )
+        return;
+
+    while( used + sz > budget && !entries.empty() )
+    {
+        used -= imageBytes(entries.back().second);
+        index.erase(entries.back().first);
+        entries.pop_back();
+    }
+    entries.push_front(make_pair(key, img));
+    index[key] = entries.begin();
+    used += sz;
+}
+
+bool ImageCache::get(const string& key, Mat& img)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    map<string, EntryList::iterator>::iterator it = index.find(key);
+    if( it == index.end() )
+    {
+        nmisses++;
+        return false;
+    }
+    entries.splice(entries.begin(), entries, it->second);
+    img = it->second->second;
+    nhits++;
+    return true;
+}
+
+void ImageCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    entries.clear();
+    index.clear();
+    used = 0;
+}
+
+size_t ImageCache::size() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return entries.size();
+}
+
+size_t ImageCache::bytes() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return used;
+}
+
+size_t ImageCache::hits() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return nhits;
+}
+
+size_t ImageCache::misses() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return nmisses;
+}
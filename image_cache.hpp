@@ -0,0 +1,46 @@
+#ifndef CALIB_IMAGE_CACHE_HPP
+#define CALIB_IMAGE_CACHE_HPP
+
+#include "opencv2/core/core.hpp"
+
+#include <list>
+#include <map>
+#include <string>
+#include <mutex>
+
+// Thread-safe in-memory image cache with a least-recently-used eviction
+// policy. Images are stored by reference (no pixel copy), and the total
+// size of the stored pixel data never exceeds the budget given to the
+// constructor.
+//
+// Lookups that miss do not insert anything: the calibration passes walk
+// the image list front to back, so with a budget smaller than the whole
+// set the most recently detected images stay cached and are hit at the
+// end of the next pass instead of being flushed by reloads of older ones.
+class ImageCache
+{
+public:
+    explicit ImageCache(size_t budgetBytes = 1024u << 20);
+
+    void put(const std::string& key, const cv::Mat& img);
+    bool get(const std::string& key, cv::Mat& img);
+    void clear();
+
+    size_t size() const;
+    size_t bytes() const;
+    size_t hits() const;
+    size_t misses() const;
+
+private:
+    typedef std::list<std::pair<std::string, cv::Mat> > EntryList;
+
+    EntryList entries;  // most recently used first
+    std::map<std::string, EntryList::iterator> index;
+    size_t budget, used, nhits, nmisses;
+    mutable std::mutex mtx;
+
+    ImageCache(const ImageCache&);
+    ImageCache& operator=(const ImageCache&);
+};
+
+#endif
@@ -0,0 +1,109 @@
+#include "image_loader.hpp"
+#include "metrics.hpp"
+
+#include "opencv2/highgui/highgui.hpp"
+
+#include <algorithm>
+
+using namespace cv;
+using namespace std;
+
+ImagePrefetcher::ImagePrefetcher(const vector<string>& _files, int _flags,
+                                 int ndecoders, int _maxAhead, size_t _budgetBytes, Metrics* _metrics)
+    : files(_files), flags(_flags), maxAhead(std::max(_maxAhead, 1)), budgetBytes(_budgetBytes),
+      metrics(_metrics),
+      slots(_files.size()), nextDecode(0), buffered(0), bytes(0), peak(0),
+      stop(false), stall(0), decode(0)
+{
+    ndecoders = std::max(1, std::min(ndecoders, (int)files.size()));
+    for( int t = 0; t < ndecoders; t++ )
+        decoders.push_back(std::thread(&ImagePrefetcher::decodeLoop, this));
+}
+
+ImagePrefetcher::~ImagePrefetcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stop = true;
+    }
+    spaceCond.notify_all();
+    for( size_t t = 0; t < decoders.size(); t++ )
+        decoders[t].join();
+}
+
+void ImagePrefetcher::decodeLoop()
+{
+    const int n = (int)files.size();
+    std::unique_lock<std::mutex> lock(mtx);
+    for( ;; )
+    {
+        // always let one image through, otherwise a single image larger
+        // than the budget would stall the pipeline forever
+        spaceCond.wait(lock, [&]() {
+            return stop || nextDecode >= n || buffered == 0 ||
+                   (buffered < maxAhead && bytes < budgetBytes);
+        });
+        if( stop || nextDecode >= n )
+            return;
+        int i = nextDecode++;
+        buffered++;
+        lock.unlock();
+
+        int64 t0 = getTickCount();
+        StageTimer timer(metrics, "load", i);
+        Mat img = imread(files[i], flags);
+        timer.stop();
+        double dt = (getTickCount() - t0)/getTickFrequency();
+
+        lock.lock();
+        Slot& s = slots[i];
+        s.img = img;
+        s.bytes = img.total()*img.elemSize();
+        s.state = READY;
+        bytes += s.bytes;
+        peak = std::max(peak, bytes);
+        decode += dt;
+        readyCond.notify_all();
+    }
+}
+
+Mat ImagePrefetcher::take(int i)
+{
+    CV_Assert( 0 <= i && i < (int)slots.size() );
+    std::unique_lock<std::mutex> lock(mtx);
+    Slot& s = slots[i];
+    CV_Assert( s.state != TAKEN );
+
+    if( s.state != READY )
+    {
+        int64 t0 = getTickCount();
+        readyCond.wait(lock, [&]() { return s.state == READY; });
+        stall += (getTickCount() - t0)/getTickFrequency();
+    }
+
+    Mat img = s.img;
+    s.img.release();
+    s.state = TAKEN;
+    bytes -= s.bytes;
+    buffered--;
+    spaceCond.notify_all();
+    return img;
+}
+
+double ImagePrefetcher::stallSeconds() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return stall;
+}
+
+double ImagePrefetcher::decodeSeconds() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return decode;
+}
+
+size_t ImagePrefetcher::peakBytes() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return peak;
+}
@@ -0,0 +1,78 @@
+#ifndef CALIB_IMAGE_LOADER_HPP
+#define CALIB_IMAGE_LOADER_HPP
+
+#include "opencv2/core/core.hpp"
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+class Metrics;
+
+// Decodes the images of a file list on background threads, in list order,
+// so that disk I/O and decoding overlap with corner detection.
+//
+// At most maxAhead images are decoded-but-not-yet-taken (or being decoded)
+// at any time, and no new decode is started while the buffered images use
+// more than budgetBytes, so memory stays bounded for arbitrarily long lists.
+// Every index must be taken exactly once, in roughly increasing order
+// (several consumers may take concurrently); an index that is never taken
+// keeps its slot of the window occupied until the prefetcher is destroyed.
+// With metrics, every decode is recorded as a "load" event whose item is
+// the index in the prefetcher's file list.
+class ImagePrefetcher
+{
+public:
+    ImagePrefetcher(const std::vector<std::string>& files, int flags = 0,
+                    int ndecoders = 1, int maxAhead = 8, size_t budgetBytes = 256u << 20,
+                    Metrics* metrics = 0);
+    ~ImagePrefetcher();
+
+    // Blocks until image i is decoded and hands it over. Returns an empty
+    // Mat if the file could not be read.
+    cv::Mat take(int i);
+
+    int size() const { return (int)files.size(); }
+
+    // Accumulated time consumers spent blocked in take(), the time the
+    // decoder threads spent in imread(), and the peak of buffered bytes.
+    double stallSeconds() const;
+    double decodeSeconds() const;
+    size_t peakBytes() const;
+
+private:
+    enum { PENDING = 0, READY = 1, TAKEN = 2 };
+    struct Slot
+    {
+        Slot() : state(PENDING), bytes(0) {}
+        int state;
+        size_t bytes;
+        cv::Mat img;
+    };
+
+    void decodeLoop();
+
+    std::vector<std::string> files;
+    int flags;
+    int maxAhead;
+    size_t budgetBytes;
+    Metrics* metrics;
+
+    std::vector<Slot> slots;
+    int nextDecode;
+    int buffered;
+    size_t bytes, peak;
+    bool stop;
+    double stall, decode;
+
+    mutable std::mutex mtx;
+    std::condition_variable readyCond, spaceCond;
+    std::vector<std::thread> decoders;
+
+    ImagePrefetcher(const ImagePrefetcher&);
+    ImagePrefetcher& operator=(const ImagePrefetcher&);
+};
+
+#endif
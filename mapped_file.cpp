@@ -0,0 +1,180 @@
+#include "mapped_file.hpp"
+
+#include <stdio.h>
+#include <atomic>
+#include <functional>
+#include <thread>
+
+#ifdef _WIN32
+# ifndef NOMINMAX
+#  define NOMINMAX
+# endif
+# include <windows.h>
+# include <process.h>
+# define getpid _getpid
+#else
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
+MappedFile::MappedFile() : ptr(0), len(0), opened(false)
+#ifdef _WIN32
+    , file(INVALID_HANDLE_VALUE), mapping(0)
+#endif
+{
+}
+
+MappedFile::MappedFile(const std::string& path) : ptr(0), len(0), opened(false)
+#ifdef _WIN32
+    , file(INVALID_HANDLE_VALUE), mapping(0)
+#endif
+{
+    open(path);
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& path)
+{
+    close();
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, 0,
+                       OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if( file == INVALID_HANDLE_VALUE )
+        return false;
+    LARGE_INTEGER fsize;
+    if( !GetFileSizeEx(file, &fsize) )
+    {
+        close();
+        return false;
+    }
+    len = (size_t)fsize.QuadPart;
+    opened = true;
+    if( len == 0 )
+        return true;
+    mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+    if( mapping )
+        ptr = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if( !ptr )
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::close()
+{
+    if( ptr )
+        UnmapViewOfFile(ptr);
+    if( mapping )
+        CloseHandle(mapping);
+    if( file != INVALID_HANDLE_VALUE )
+        CloseHandle(file);
+    ptr = 0;
+    len = 0;
+    mapping = 0;
+    file = INVALID_HANDLE_VALUE;
+    opened = false;
+}
+
+#else
+
+bool MappedFile::open(const std::string& path)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if( fd < 0 )
+        return false;
+    struct stat st;
+    if( fstat(fd, &st) != 0 )
+    {
+        ::close(fd);
+        return false;
+    }
+    len = (size_t)st.st_size;
+    if( len > 0 )
+    {
+        void* p = mmap(0, len, PROT_READ, MAP_SHARED, fd, 0);
+        if( p == MAP_FAILED )
+        {
+            ::close(fd);
+            len = 0;
+            return false;
+        }
+        ptr = (const unsigned char*)p;
+    }
+    // the mapping stays valid after the descriptor is closed
+    ::close(fd);
+    opened = true;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if( ptr )
+        munmap((void*)ptr, len);
+    ptr = 0;
+    len = 0;
+    opened = false;
+}
+
+#endif
+
+bool writeFileAtomic(const std::string& path, const FileChunk* chunks, int nchunks)
+{
+    // unique per process and thread, so writers never share a temp file
+    static std::atomic<unsigned> counter(0);
+    char suffix[64];
+    sprintf(suffix, ".%d.%u.%u.tmp", (int)getpid(),
+            (unsigned)std::hash<std::thread::id>()(std::this_thread::get_id()), (unsigned)counter++);
+    std::string tmpPath = path + suffix;
+
+    FILE* f = fopen(tmpPath.c_str(), "wb");
+    if( !f )
+        return false;
+    bool ok = true;
+    for( int i = 0; i < nchunks && ok; i++ )
+        ok = chunks[i].size == 0 || fwrite(chunks[i].data, chunks[i].size, 1, f) == 1;
+    ok = fclose(f) == 0 && ok;
+#ifdef _WIN32
+    ok = ok && MoveFileExA(tmpPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    ok = ok && rename(tmpPath.c_str(), path.c_str()) == 0;
+#endif
+    if( !ok )
+        remove(tmpPath.c_str());
+    return ok;
+}
+
+bool makeDirs(const std::string& dir)
+{
+    if( dir.empty() )
+        return false;
+    // every parent first; failures (e.g. "C:" or an existing directory)
+    // only matter for dir itself, checked below
+    for( size_t pos = dir.find_first_of("/\\", 1); ; pos = dir.find_first_of("/\\", pos + 1) )
+    {
+        std::string part = dir.substr(0, pos);
+#ifdef _WIN32
+        CreateDirectoryA(part.c_str(), 0);
+#else
+        mkdir(part.c_str(), 0777);
+#endif
+        if( pos == std::string::npos )
+            break;
+    }
+#ifdef _WIN32
+    DWORD attr = GetFileAttributesA(dir.c_str());
+    return attr != INVALID_FILE_ATTRIBUTES && (attr & FILE_ATTRIBUTE_DIRECTORY) != 0;
+#else
+    struct stat st;
+    return stat(dir.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+#endif
+}
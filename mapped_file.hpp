@@ -0,0 +1,52 @@
+#ifndef CALIB_MAPPED_FILE_HPP
+#define CALIB_MAPPED_FILE_HPP
+
+#include <stddef.h>
+#include <string>
+
+// Read-only memory mapping of a whole file. Several processes mapping the
+// same file share its pages through the OS page cache.
+class MappedFile
+{
+public:
+    MappedFile();
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpened() const { return opened; }
+    const unsigned char* data() const { return ptr; }
+    size_t size() const { return len; }
+
+private:
+    const unsigned char* ptr;
+    size_t len;
+    bool opened;
+#ifdef _WIN32
+    void* file;
+    void* mapping;
+#endif
+
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+};
+
+struct FileChunk
+{
+    const void* data;
+    size_t size;
+};
+
+// Writes the chunks one after another to a temporary file private to the
+// calling process and thread, then renames it to path (replacing an older
+// file). Readers, including ones that map the file, therefore see either
+// the previous or the complete new contents, never a partial write.
+bool writeFileAtomic(const std::string& path, const FileChunk* chunks, int nchunks);
+
+// Creates dir and any missing parent directories. Returns true if dir
+// exists as a directory afterwards.
+bool makeDirs(const std::string& dir);
+
+#endif
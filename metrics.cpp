@@ -0,0 +1,192 @@
+#include "metrics.hpp"
+
+#include <chrono>
+
+#ifdef _WIN32
+# ifndef NOMINMAX
+#  define NOMINMAX
+# endif
+# include <windows.h>
+#else
+# include <time.h>
+#endif
+
+using namespace std;
+
+static double wallSeconds()
+{
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+double threadCpuSeconds()
+{
+#ifdef _WIN32
+    FILETIME creation, exitTime, kernel, user;
+    if( !GetThreadTimes(GetCurrentThread(), &creation, &exitTime, &kernel, &user) )
+        return 0;
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime; k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime; u.HighPart = user.dwHighDateTime;
+    return (double)(k.QuadPart + u.QuadPart)*1e-7;
+#else
+    timespec ts;
+    if( clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0 )
+        return 0;
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+#endif
+}
+
+Metrics::Metrics() : f(0), csv(false), keep(false), t0(wallSeconds())
+{
+}
+
+Metrics::Metrics(const string& filename) : f(0), csv(false), keep(false), t0(wallSeconds())
+{
+    open(filename);
+}
+
+Metrics::~Metrics()
+{
+    close();
+}
+
+bool Metrics::open(const string& filename)
+{
+    close();
+    std::lock_guard<std::mutex> lock(mtx);
+    f = fopen(filename.c_str(), "wt");
+    if( !f )
+        return false;
+    csv = filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".csv") == 0;
+    if( csv )
+        fprintf(f, "type,t_ms,stage,item,scale,wall_ms,cpu_ms,count\n");
+    t0 = wallSeconds();
+    totals.clear();
+    return true;
+}
+
+void Metrics::close()
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    if( !f )
+        return;
+    for( map<string, Total>::const_iterator it = totals.begin(); it != totals.end(); ++it )
+    {
+        const Total& t = it->second;
+        if( t.count > 0 )
+        {
+            if( csv )
+                fprintf(f, "total,,%s,,,%.3f,%.3f,%ld\n", it->first.c_str(), t.wallMs, t.cpuMs, t.count);
+            else
+                fprintf(f, "{\"type\":\"total\",\"stage\":\"%s\",\"wall_ms\":%.3f,\"cpu_ms\":%.3f,\"count\":%ld}\n",
+                        it->first.c_str(), t.wallMs, t.cpuMs, t.count);
+        }
+        if( t.rejected > 0 )
+        {
+            if( csv )
+                fprintf(f, "rejected,,%s,,,,,%ld\n", it->first.c_str(), t.rejected);
+            else
+                fprintf(f, "{\"type\":\"rejected\",\"stage\":\"%s\",\"count\":%ld}\n",
+                        it->first.c_str(), t.rejected);
+        }
+    }
+    fclose(f);
+    f = 0;
+}
+
+bool Metrics::isOpened() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return f != 0;
+}
+
+bool Metrics::isActive() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return f != 0 || keep;
+}
+
+void Metrics::keepSamples(bool on)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    keep = on;
+}
+
+vector<double> Metrics::samples(const string& stage) const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    map<string, vector<double> >::const_iterator it = wallSamples.find(stage);
+    return it != wallSamples.end() ? it->second : vector<double>();
+}
+
+vector<string> Metrics::stages() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    vector<string> names;
+    for( map<string, Total>::const_iterator it = totals.begin(); it != totals.end(); ++it )
+        names.push_back(it->first);
+    return names;
+}
+
+long Metrics::rejected(const string& stage) const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    map<string, Total>::const_iterator it = totals.find(stage);
+    return it != totals.end() ? it->second.rejected : 0;
+}
+
+void Metrics::record(const char* stage, double wallMs, double cpuMs, int item, double scale)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    if( !f && !keep )
+        return;
+    if( keep )
+        wallSamples[stage].push_back(wallMs);
+    Total& total = totals[stage];
+    total.count++;
+    total.wallMs += wallMs;
+    total.cpuMs += cpuMs;
+    if( !f )
+        return;
+
+    double t = (wallSeconds() - t0)*1000.;
+    if( csv )
+        fprintf(f, "event,%.3f,%s,%d,%g,%.3f,%.3f,\n", t, stage, item, scale, wallMs, cpuMs);
+    else
+    {
+        fprintf(f, "{\"type\":\"event\",\"t_ms\":%.3f,\"stage\":\"%s\"", t, stage);
+        if( item >= 0 )
+            fprintf(f, ",\"item\":%d", item);
+        if( scale != 0 )
+            fprintf(f, ",\"scale\":%g", scale);
+        fprintf(f, ",\"wall_ms\":%.3f,\"cpu_ms\":%.3f}\n", wallMs, cpuMs);
+    }
+    // keep the file current for jobs that are watched or killed midway
+    fflush(f);
+}
+
+void Metrics::reject(const char* stage, int count)
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    if( f || keep )
+        totals[stage].rejected += count;
+}
+
+StageTimer::StageTimer(Metrics* _metrics, const char* _stage, int _item, double _scale)
+    : metrics(_metrics && _metrics->isActive() ? _metrics : 0),
+      stage(_stage), item(_item), scale(_scale), wall0(0), cpu0(0)
+{
+    if( metrics )
+    {
+        wall0 = wallSeconds();
+        cpu0 = threadCpuSeconds();
+    }
+}
+
+void StageTimer::stop()
+{
+    if( !metrics )
+        return;
+    metrics->record(stage, (wallSeconds() - wall0)*1000., (threadCpuSeconds() - cpu0)*1000., item, scale);
+    metrics = 0;
+}
@@ -0,0 +1,90 @@
+#ifndef CALIB_METRICS_HPP
+#define CALIB_METRICS_HPP
+
+#include <stdio.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Streams per-stage timings of the calibration pipeline to a file.
+//
+// Every timed event becomes one line as soon as it is recorded, either as
+// a JSON object (default) or as a CSV row when the file name ends with
+// ".csv". Closing the sink appends one "total" line per stage (event count,
+// summed wall and CPU time) and one "rejected" line per stage that dropped
+// frames. With keepSamples() the wall time of every event is also kept in
+// memory, e.g. for latency percentiles. All methods are thread-safe; a sink
+// that is neither opened nor keeping samples ignores everything, and all
+// helpers accept a null Metrics pointer, so instrumented code pays nothing
+// when metrics are off.
+//
+// CPU time is the CPU time of the calling thread, so for stages that
+// OpenCV parallelizes internally it can be lower than the wall time.
+class Metrics
+{
+public:
+    Metrics();
+    explicit Metrics(const std::string& filename);
+    ~Metrics();
+
+    bool open(const std::string& filename);
+    void close();
+    bool isOpened() const;
+    bool isActive() const;
+
+    void keepSamples(bool on);
+    // wall times (ms) of all events of a stage, in recording order
+    std::vector<double> samples(const std::string& stage) const;
+    std::vector<std::string> stages() const;
+    long rejected(const std::string& stage) const;
+
+    // item: image or frame index, -1 if not applicable;
+    // scale: detection scale factor, 0 if not applicable.
+    void record(const char* stage, double wallMs, double cpuMs, int item = -1, double scale = 0);
+    void reject(const char* stage, int count = 1);
+
+private:
+    struct Total
+    {
+        Total() : count(0), wallMs(0), cpuMs(0), rejected(0) {}
+        long count;
+        double wallMs, cpuMs;
+        long rejected;
+    };
+
+    FILE* f;
+    bool csv, keep;
+    double t0;
+    std::map<std::string, Total> totals;
+    std::map<std::string, std::vector<double> > wallSamples;
+    mutable std::mutex mtx;
+
+    Metrics(const Metrics&);
+    Metrics& operator=(const Metrics&);
+};
+
+// CPU time consumed so far by the calling thread, in seconds.
+double threadCpuSeconds();
+
+// Records the wall and CPU time between construction and stop() (or
+// destruction) as one event of the given stage.
+class StageTimer
+{
+public:
+    StageTimer(Metrics* metrics, const char* stage, int item = -1, double scale = 0);
+    ~StageTimer() { stop(); }
+    void stop();
+
+private:
+    Metrics* metrics;
+    const char* stage;
+    int item;
+    double scale;
+    double wall0, cpu0;
+
+    StageTimer(const StageTimer&);
+    StageTimer& operator=(const StageTimer&);
+};
+
+#endif
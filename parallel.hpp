@@ -0,0 +1,203 @@
+#ifndef CALIB_PARALLEL_HPP
+#define CALIB_PARALLEL_HPP
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <vector>
+
+// Resolves a user supplied thread count: values <= 0 mean "one per core".
+inline int resolveThreadCount(int nthreads)
+{
+    if( nthreads > 0 )
+        return nthreads;
+    unsigned hw = std::thread::hardware_concurrency();
+    return hw > 0 ? (int)hw : 1;
+}
+
+// Calls body(i, tid) for every i in [0, n) using up to nthreads workers,
+// where tid in [0, nthreads) identifies the worker (handy for per-thread
+// scratch buffers). Indices are handed out one by one in increasing order,
+// so items with very different costs (e.g. failed chessboard detections
+// that retry at a larger scale) do not leave workers idle the way fixed
+// chunks would. The first exception thrown by a body is rethrown here.
+template<typename Body>
+void parallelFor(int n, int nthreads, const Body& body)
+{
+    nthreads = resolveThreadCount(nthreads);
+    if( nthreads > n )
+        nthreads = n;
+    if( nthreads <= 1 )
+    {
+        for( int i = 0; i < n; i++ )
+            body(i, 0);
+        return;
+    }
+
+    std::atomic<int> next(0);
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    std::vector<std::thread> workers;
+    workers.reserve(nthreads);
+
+    for( int t = 0; t < nthreads; t++ )
+        workers.push_back(std::thread([&, t]()
+        {
+            for( ;; )
+            {
+                int i = next++;
+                if( i >= n )
+                    break;
+                try
+                {
+                    body(i, t);
+                }
+                catch(...)
+                {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if( !error )
+                        error = std::current_exception();
+                    next = n; // stop handing out work
+                }
+            }
+        }));
+
+    for( size_t t = 0; t < workers.size(); t++ )
+        workers[t].join();
+    if( error )
+        std::rethrow_exception(error);
+}
+
+// Worker threads that stay alive between parallel loops, for code that
+// runs a short loop per frame and should not start and join threads each
+// time. run() hands out indices like parallelFor(); the calling thread
+// works as tid 0, so a pool of nthreads keeps nthreads-1 threads waiting.
+// run() may not be called from two threads at once.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(int nthreads = 1) : job(0), jobSize(0), next(0), generation(0), busy(0), quit(false)
+    {
+        start(nthreads);
+    }
+    ~ThreadPool() { stop(); }
+
+    // Stops the current threads and starts nthreads-1 new ones
+    // (nthreads <= 0: one per core).
+    void reset(int nthreads)
+    {
+        stop();
+        start(nthreads);
+    }
+    int size() const { return (int)threads.size() + 1; }
+
+    // Calls body(i, tid) for every i in [0, n), tid in [0, size()).
+    // The first exception thrown by a body is rethrown here.
+    void run(int n, const std::function<void(int, int)>& body)
+    {
+        if( threads.empty() || n <= 1 )
+        {
+            for( int i = 0; i < n; i++ )
+                body(i, 0);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            job = &body;
+            jobSize = n;
+            next = 0;
+            error = std::exception_ptr();
+            busy = (int)threads.size();
+            generation++;
+        }
+        wake.notify_all();
+        work(0);
+        std::unique_lock<std::mutex> lock(mtx);
+        done.wait(lock, [this]() { return busy == 0; });
+        job = 0;
+        if( error )
+            std::rethrow_exception(error);
+    }
+
+private:
+    std::vector<std::thread> threads;
+    std::mutex mtx;
+    std::condition_variable wake, done;
+    const std::function<void(int, int)>* job;
+    int jobSize;
+    std::atomic<int> next;
+    unsigned generation;
+    int busy;
+    bool quit;
+    std::exception_ptr error;
+
+    void start(int nthreads)
+    {
+        nthreads = resolveThreadCount(nthreads);
+        quit = false;
+        // the threads start from the current generation, so a run() that
+        // comes before they first wait is not missed
+        unsigned seen = generation;
+        for( int t = 1; t < nthreads; t++ )
+            threads.push_back(std::thread([this, t, seen]() { loop(t, seen); }));
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            quit = true;
+        }
+        wake.notify_all();
+        for( size_t t = 0; t < threads.size(); t++ )
+            threads[t].join();
+        threads.clear();
+    }
+
+    void loop(int tid, unsigned seen)
+    {
+        for( ;; )
+        {
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                wake.wait(lock, [&]() { return quit || generation != seen; });
+                if( quit )
+                    return;
+                seen = generation;
+            }
+            work(tid);
+            std::lock_guard<std::mutex> lock(mtx);
+            if( --busy == 0 )
+                done.notify_one();
+        }
+    }
+
+    void work(int tid)
+    {
+        for( ;; )
+        {
+            int i = next++;
+            if( i >= jobSize )
+                break;
+            try
+            {
+                (*job)(i, tid);
+            }
+            catch(...)
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                if( !error )
+                    error = std::current_exception();
+                next = jobSize; // stop handing out work
+            }
+        }
+    }
+
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+};
+
+#endif
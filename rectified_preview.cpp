@@ -0,0 +1,56 @@
+#include "rectified_preview.hpp"
+
+#include "opencv2/calib3d/calib3d.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include <algorithm>
+
+using namespace cv;
+
+void RectifiedPreview::init(const Mat* cameraMatrix, const Mat* distCoeffs,
+                            const Mat* R, const Mat* P, Size _imageSize, double _scale)
+{
+    CV_Assert( _scale > 0 );
+    imageSize = _imageSize;
+    scale = _scale;
+    previewSize = Size(cvRound(imageSize.width*scale), cvRound(imageSize.height*scale));
+
+    // pyrDown maps pixel 2x of its source to x, so a pyramid level is the
+    // camera with a scaled focal length and principal point
+    nlevels = 0;
+    double levelScale = 1;
+    while( scale/levelScale < 0.5 && std::min(imageSize.width, imageSize.height)*levelScale >= 32 )
+    {
+        levelScale *= 0.5;
+        nlevels++;
+    }
+    Mat A = (Mat_<double>(3, 3) << levelScale, 0, 0, 0, levelScale, 0, 0, 0, 1);
+    // preview pixels cover scale x scale source pixels; align their centers
+    double o = 0.5*scale - 0.5;
+    Mat B = (Mat_<double>(3, 3) << scale, 0, o, 0, scale, o, 0, 0, 1);
+
+    for( int k = 0; k < 2; k++ )
+    {
+        Mat K, newP;
+        Mat(A*cameraMatrix[k]).convertTo(K, CV_64F);
+        Mat P64;
+        P[k].convertTo(P64, CV_64F);
+        newP = B*P64;
+        initUndistortRectifyMap(K, distCoeffs[k], R[k], newP, previewSize, CV_16SC2, maps[k][0], maps[k][1]);
+    }
+}
+
+void RectifiedPreview::render(int k, const Mat& gray, Mat& dst)
+{
+    CV_Assert( 0 <= k && k < 2 && !maps[k][0].empty() && gray.type() == CV_8UC1 );
+    const Mat* src = &gray;
+    for( int l = 0; l < nlevels; l++ )
+    {
+        pyrDown(*src, pyr[l & 1]);
+        src = &pyr[l & 1];
+    }
+    remap(*src, rectified, maps[k][0], maps[k][1], INTER_LINEAR);
+    // dst keeps its data (and stays a view into the canvas) when the size
+    // and type already match
+    cvtColor(rectified, dst, COLOR_GRAY2BGR);
+}
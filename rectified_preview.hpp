@@ -0,0 +1,43 @@
+#ifndef CALIB_RECTIFIED_PREVIEW_HPP
+#define CALIB_RECTIFIED_PREVIEW_HPP
+
+#include "opencv2/core/core.hpp"
+
+// Renders rectified, downscaled color previews of a stereo pair.
+//
+// Instead of rectifying at full resolution and shrinking the result, the
+// remap tables are built for the preview size directly, so the remap only
+// touches preview pixels. Large reductions first go down a Gaussian
+// pyramid until at most a factor of two is left, which keeps the bilinear
+// sampling from aliasing; the tables are built for that pyramid level.
+// The gray-to-BGR conversion runs at preview size and writes straight
+// into the destination, typically a canvas ROI. remap, pyrDown and
+// cvtColor are OpenCV's vectorized kernels.
+//
+// The scratch buffers are shared by both cameras, so one instance must not
+// render from two threads at once.
+class RectifiedPreview
+{
+public:
+    RectifiedPreview() : nlevels(0), scale(0) {}
+
+    // scale: preview size / image size
+    void init(const cv::Mat* cameraMatrix, const cv::Mat* distCoeffs,
+              const cv::Mat* R, const cv::Mat* P, cv::Size imageSize, double scale);
+
+    // Rectifies the 8-bit grayscale image of camera k (0 = left, 1 = right)
+    // into dst, which must be (or becomes) a CV_8UC3 image of size().
+    void render(int k, const cv::Mat& gray, cv::Mat& dst);
+
+    cv::Size size() const { return previewSize; }
+    int levels() const { return nlevels; }
+
+private:
+    int nlevels;
+    double scale;
+    cv::Size imageSize, previewSize;
+    cv::Mat maps[2][2];
+    cv::Mat pyr[2], rectified;
+};
+
+#endif
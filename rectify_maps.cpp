@@ -0,0 +1,159 @@
+#include "rectify_maps.hpp"
+#include "hash.hpp"
+
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include <stddef.h>
+#include <string.h>
+#include <algorithm>
+
+using namespace cv;
+using namespace std;
+
+namespace
+{
+const char RECTIFY_MAPS_MAGIC[8] = { 'C','A','L','B','R','M','A','P' };
+const uint32_t RECTIFY_MAPS_VERSION = 2;
+
+struct RectifyMapsHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t key;
+    int32_t width, height;
+    int32_t mapType, weightType;
+    uint64_t reserved[2];
+    uint64_t checksum;   // of the header fields above
+};
+
+uint64_t headerChecksum(const RectifyMapsHeader& hdr)
+{
+    return hashBytes(&hdr, offsetof(RectifyMapsHeader, checksum));
+}
+
+uint64_t hashMat(uint64_t h, const Mat& m)
+{
+    Mat m64;
+    m.convertTo(m64, CV_64F);
+    h = hashValue(h, m64.rows);
+    h = hashValue(h, m64.cols);
+    for( int i = 0; i < m64.rows; i++ )
+        h = hashBytes(m64.ptr(i), m64.cols*m64.elemSize(), h);
+    return h;
+}
+}
+
+uint64_t RectifyMaps::key(const Mat* cameraMatrix, const Mat* distCoeffs,
+                          const Mat* R, const Mat* P, Size imageSize)
+{
+    uint64_t h = hashBytes(RECTIFY_MAPS_MAGIC, sizeof(RECTIFY_MAPS_MAGIC));
+    h = hashValue(h, RECTIFY_MAPS_VERSION);
+    h = hashValue(h, imageSize.width);
+    h = hashValue(h, imageSize.height);
+    for( int k = 0; k < 2; k++ )
+    {
+        h = hashMat(h, cameraMatrix[k]);
+        h = hashMat(h, distCoeffs[k]);
+        h = hashMat(h, R[k]);
+        h = hashMat(h, P[k]);
+    }
+    return h;
+}
+
+void RectifyMaps::compute(const Mat* cameraMatrix, const Mat* distCoeffs,
+                          const Mat* R, const Mat* P, Size imageSize)
+{
+    // fresh Mats, so the maps are not written into a read-only mapping
+    for( int k = 0; k < 2; k++ )
+        maps[k][0] = maps[k][1] = Mat();
+    file.close();
+    for( int k = 0; k < 2; k++ )
+    {
+        initUndistortRectifyMap(cameraMatrix[k], distCoeffs[k], R[k], P[k], imageSize,
+                                CV_16SC2, maps[k][0], maps[k][1]);
+    }
+}
+
+bool RectifyMaps::load(const string& path, uint64_t key)
+{
+    // drop the current maps before their backing mapping goes away
+    for( int k = 0; k < 2; k++ )
+        maps[k][0] = maps[k][1] = Mat();
+    if( !file.open(path) || file.size() < sizeof(RectifyMapsHeader) )
+    {
+        file.close();
+        return false;
+    }
+    RectifyMapsHeader hdr;
+    memcpy(&hdr, file.data(), sizeof(hdr));
+    size_t npixels = (size_t)std::max(hdr.width, 0)*std::max(hdr.height, 0);
+    size_t mapBytes = npixels*CV_ELEM_SIZE(CV_16SC2), weightBytes = npixels*CV_ELEM_SIZE(CV_16UC1);
+    if( memcmp(hdr.magic, RECTIFY_MAPS_MAGIC, sizeof(hdr.magic)) != 0 ||
+        hdr.version != RECTIFY_MAPS_VERSION || hdr.headerSize != sizeof(hdr) ||
+        hdr.checksum != headerChecksum(hdr) || hdr.key != key ||
+        hdr.mapType != CV_16SC2 || hdr.weightType != CV_16UC1 || npixels == 0 ||
+        file.size() != sizeof(hdr) + 2*(mapBytes + weightBytes) )
+    {
+        file.close();
+        return false;
+    }
+
+    // the Mats only borrow the mapped pages
+    const unsigned char* p = file.data() + sizeof(hdr);
+    for( int k = 0; k < 2; k++ )
+    {
+        maps[k][0] = Mat(hdr.height, hdr.width, CV_16SC2, (void*)p);
+        p += mapBytes;
+        maps[k][1] = Mat(hdr.height, hdr.width, CV_16UC1, (void*)p);
+        p += weightBytes;
+    }
+    return true;
+}
+
+bool RectifyMaps::save(const string& path, uint64_t key) const
+{
+    if( empty() )
+        return false;
+    Size size = maps[0][0].size();
+    RectifyMapsHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, RECTIFY_MAPS_MAGIC, sizeof(hdr.magic));
+    hdr.version = RECTIFY_MAPS_VERSION;
+    hdr.headerSize = sizeof(hdr);
+    hdr.key = key;
+    hdr.width = size.width;
+    hdr.height = size.height;
+    hdr.mapType = CV_16SC2;
+    hdr.weightType = CV_16UC1;
+    hdr.checksum = headerChecksum(hdr);
+
+    Mat m[2][2];
+    FileChunk chunks[5] = { { &hdr, sizeof(hdr) } };
+    for( int k = 0; k < 2; k++ )
+        for( int i = 0; i < 2; i++ )
+        {
+            m[k][i] = maps[k][i].isContinuous() ? maps[k][i] : maps[k][i].clone();
+            chunks[1 + k*2 + i].data = m[k][i].data;
+            chunks[1 + k*2 + i].size = m[k][i].total()*m[k][i].elemSize();
+        }
+    return writeFileAtomic(path, chunks, 5);
+}
+
+bool RectifyMaps::loadOrCompute(const string& path, const Mat* cameraMatrix, const Mat* distCoeffs,
+                                const Mat* R, const Mat* P, Size imageSize)
+{
+    uint64_t k = key(cameraMatrix, distCoeffs, R, P, imageSize);
+    if( !path.empty() && load(path, k) )
+        return true;
+    compute(cameraMatrix, distCoeffs, R, P, imageSize);
+    if( !path.empty() )
+        save(path, k);
+    return false;
+}
+
+string rectifyMapsPath(const string& extrinsicsPath)
+{
+    size_t slash = extrinsicsPath.find_last_of("/\\");
+    return (slash == string::npos ? string() : extrinsicsPath.substr(0, slash + 1)) + "rectify_maps.bin";
+}
@@ -0,0 +1,61 @@
+#ifndef CALIB_RECTIFY_MAPS_HPP
+#define CALIB_RECTIFY_MAPS_HPP
+
+#include "opencv2/core/core.hpp"
+#include "mapped_file.hpp"
+
+#include <stdint.h>
+#include <string>
+
+// Rectification maps of a stereo pair in the fixed-point format remap()
+// is fastest with: per camera a CV_16SC2 integer map and a CV_16UC1 table
+// of interpolation weights, as produced by initUndistortRectifyMap.
+//
+// The maps can be saved to a binary file: a 64-byte header followed by
+// the four maps as raw arrays. load() memory-maps that file and the maps
+// point straight into the mapping, so starting up costs no computation
+// and no copy, and processes that load the same file share one copy of
+// the pages through the OS page cache. The header holds a hash of the
+// calibration the maps were computed from (see key()); a file with a
+// different key, size or format is rejected. Files are written to a
+// temporary name and renamed into place, so readers never see a partial
+// file. Maps loaded from a file are read-only.
+class RectifyMaps
+{
+public:
+    RectifyMaps() {}
+
+    // Hash of everything the maps depend on: camera matrices, distortion,
+    // rectification rotations and projections (two of each) and the size.
+    static uint64_t key(const cv::Mat* cameraMatrix, const cv::Mat* distCoeffs,
+                        const cv::Mat* R, const cv::Mat* P, cv::Size imageSize);
+
+    void compute(const cv::Mat* cameraMatrix, const cv::Mat* distCoeffs,
+                 const cv::Mat* R, const cv::Mat* P, cv::Size imageSize);
+    bool load(const std::string& path, uint64_t key);
+    bool save(const std::string& path, uint64_t key) const;
+
+    // Loads the maps from path if it holds the maps of this calibration,
+    // otherwise computes them and (if path is not empty) saves them there.
+    // Returns true if the maps were loaded.
+    bool loadOrCompute(const std::string& path, const cv::Mat* cameraMatrix, const cv::Mat* distCoeffs,
+                       const cv::Mat* R, const cv::Mat* P, cv::Size imageSize);
+
+    bool empty() const { return maps[0][0].empty(); }
+    cv::Size size() const { return maps[0][0].size(); }
+    // camera k (0 = left, 1 = right), i = 0: CV_16SC2 map, i = 1: CV_16UC1 weights
+    const cv::Mat& map(int k, int i) const { return maps[k][i]; }
+
+private:
+    cv::Mat maps[2][2];
+    MappedFile file;
+
+    RectifyMaps(const RectifyMaps&);
+    RectifyMaps& operator=(const RectifyMaps&);
+};
+
+// Path of the map cache kept next to a calibration file, e.g.
+// "out/extrinsics.yml" -> "out/rectify_maps.bin".
+std::string rectifyMapsPath(const std::string& extrinsicsPath);
+
+#endif
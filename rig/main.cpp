@@ -0,0 +1,143 @@
+#include "opencv2/calib3d/calib3d.hpp"
+
+#include "../metrics.hpp"
+#include "../rig_calib.hpp"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+using namespace cv;
+using namespace std;
+
+static int print_help()
+{
+    cout << " Calibrates a rig of synchronized cameras from a list of chessboard images,\n"
+            " ncameras per frame (camera 0, camera 1, ..., camera 0 of the next frame, ...).\n"
+            " Camera 0 is the reference; all results go to one rig file.\n" << endl;
+    cout << "Usage:\n ./rig_calib -n ncameras -w board_width -h board_height [-s square_size]\n"
+            "   [-t threads /*0 = one per core*/] [-prefetch images_ahead] [-decoders threads]\n"
+            "   [-mem prefetch_budget_MB] [-coarse max_side_px] [-prefilter] [-corners corner_cache_dir]\n"
+            "   [-views n /*most views per camera for the intrinsics*/] [-iter n /*joint solve iterations*/]\n"
+            "   [-rational /*8 coefficient distortion model*/] [-o rig.yml]\n"
+            "   [-metrics file.jsonl|file.csv] <image list XML/YML file>\n" << endl;
+    return 0;
+}
+
+static bool readStringList( const string& filename, vector<string>& l )
+{
+    l.resize(0);
+    FileStorage fs(filename, FileStorage::READ);
+    if( !fs.isOpened() )
+        return false;
+    FileNode n = fs.getFirstTopLevelNode();
+    if( n.type() != FileNode::SEQ )
+        return false;
+    FileNodeIterator it = n.begin(), it_end = n.end();
+    for( ; it != it_end; ++it )
+        l.push_back((string)*it);
+    return true;
+}
+
+// Reads the value of the option at argv[i].
+static bool intArg(int argc, char** argv, int& i, int& value, int minValue)
+{
+    return i+1 < argc && sscanf(argv[++i], "%d", &value) == 1 && value >= minValue;
+}
+
+int main(int argc, char** argv)
+{
+    RigCalibOptions opts;
+    Size boardSize;
+    int ncameras = 0;
+    string imagelistfn, outputFile = "rig.yml", metricsFile;
+
+    for( int i = 1; i < argc; i++ )
+    {
+        string arg = argv[i];
+        bool hasValue = i+1 < argc;
+        bool ok = true;
+        if( arg == "-n" )
+            ok = intArg(argc, argv, i, ncameras, 1);
+        else if( arg == "-w" )
+            ok = intArg(argc, argv, i, boardSize.width, 1);
+        else if( arg == "-h" )
+            ok = intArg(argc, argv, i, boardSize.height, 1);
+        else if( arg == "-t" )
+            ok = intArg(argc, argv, i, opts.nthreads, 0);
+        else if( arg == "-prefetch" )
+            ok = intArg(argc, argv, i, opts.prefetch, 0);
+        else if( arg == "-decoders" )
+            ok = intArg(argc, argv, i, opts.decoders, 0);
+        else if( arg == "-mem" )
+            ok = intArg(argc, argv, i, opts.prefetchBudgetMB, 1);
+        else if( arg == "-coarse" )
+            ok = intArg(argc, argv, i, opts.coarseSize, 0);
+        else if( arg == "-views" )
+            ok = intArg(argc, argv, i, opts.maxViews, 3);
+        else if( arg == "-iter" )
+            ok = intArg(argc, argv, i, opts.maxIterations, 0);
+        else if( arg == "-s" )
+        {
+            if( !hasValue || sscanf(argv[++i], "%f", &opts.squareSize) != 1 || opts.squareSize <= 0 )
+            {
+                cout << "invalid square size" << endl;
+                return print_help();
+            }
+        }
+        else if( arg == "-prefilter" )
+            opts.prefilter = true;
+        else if( arg == "-rational" )
+            opts.flags |= CALIB_RATIONAL_MODEL;
+        else if( arg == "-corners" && hasValue )
+            opts.cornerCacheDir = argv[++i];
+        else if( arg == "-o" && hasValue )
+            outputFile = argv[++i];
+        else if( arg == "-metrics" && hasValue )
+            metricsFile = argv[++i];
+        else if( arg == "--help" )
+            return print_help();
+        else if( arg[0] == '-' )
+        {
+            cout << "invalid option " << arg << endl;
+            return print_help();
+        }
+        else
+            imagelistfn = arg;
+
+        if( !ok )
+        {
+            cout << "invalid value of " << arg << endl;
+            return print_help();
+        }
+    }
+
+    if( imagelistfn.empty() || ncameras < 2 || boardSize.width <= 0 || boardSize.height <= 0 )
+        return print_help();
+    vector<string> imagelist;
+    if( !readStringList(imagelistfn, imagelist) || imagelist.empty() )
+    {
+        cout << "can not open " << imagelistfn << " or the string list is empty" << endl;
+        return print_help();
+    }
+
+    Metrics metrics;
+    if( !metricsFile.empty() && !metrics.open(metricsFile) )
+        cout << "Error: can not open the metrics file " << metricsFile << endl;
+    opts.metrics = &metrics;
+
+    RigObservations obs;
+    if( !detectRigCorners(imagelist, ncameras, boardSize, opts, obs) )
+        return -1;
+    RigCalibration rig;
+    if( !calibrateRig(obs, boardSize, opts, rig) )
+        return -1;
+    if( !rig.save(outputFile) )
+    {
+        cout << "Error: can not save the rig calibration to " << outputFile << endl;
+        return -1;
+    }
+    cout << "Rig calibration written to " << outputFile << endl;
+    return 0;
+}
@@ -0,0 +1,630 @@
+#include "rig_calib.hpp"
+#include "corner_cache.hpp"
+#include "detect.hpp"
+#include "image_loader.hpp"
+#include "metrics.hpp"
+#include "parallel.hpp"
+#include "view_selection.hpp"
+
+#include "opencv2/calib3d/calib3d.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <math.h>
+
+using namespace cv;
+using namespace std;
+
+namespace
+{
+const int MAX_SCALE = 2;
+const int MIN_INTRINSIC_VIEWS = 3;
+
+// A pose as (rotation vector, translation): x' = R(r)*x + t.
+typedef Vec6d Pose;
+
+Matx31d rot(const Pose& p) { return Matx31d(p[0], p[1], p[2]); }
+Matx31d trans(const Pose& p) { return Matx31d(p[3], p[4], p[5]); }
+
+Pose makePose(const Mat& r, const Mat& t)
+{
+    Mat r64, t64;
+    r.convertTo(r64, CV_64F);
+    t.convertTo(t64, CV_64F);
+    const double* rp = r64.ptr<double>();
+    const double* tp = t64.ptr<double>();
+    return Pose(rp[0], rp[1], rp[2], tp[0], tp[1], tp[2]);
+}
+
+// a first, then b
+Pose compose(const Pose& a, const Pose& b)
+{
+    Mat r, t;
+    composeRT(rot(a), trans(a), rot(b), trans(b), r, t);
+    return makePose(r, t);
+}
+
+Pose inverse(const Pose& p)
+{
+    Matx33d R;
+    Rodrigues(rot(p), R);
+    Matx31d t = -(R.t()*trans(p));
+    return Pose(-p[0], -p[1], -p[2], t(0), t(1), t(2));
+}
+
+// Derivatives of a composed pose with respect to one of its parts.
+Matx66d chain(const Mat& drdr, const Mat& drdt, const Mat& dtdr, const Mat& dtdt)
+{
+    Matx66d A;
+    for( int i = 0; i < 3; i++ )
+        for( int j = 0; j < 3; j++ )
+        {
+            A(i, j) = drdr.at<double>(i, j);
+            A(i, j + 3) = drdt.at<double>(i, j);
+            A(i + 3, j) = dtdr.at<double>(i, j);
+            A(i + 3, j + 3) = dtdt.at<double>(i, j);
+        }
+    return A;
+}
+
+vector<Point3f> boardPoints(Size boardSize, float squareSize)
+{
+    vector<Point3f> pts;
+    for( int i = 0; i < boardSize.height; i++ )
+        for( int j = 0; j < boardSize.width; j++ )
+            pts.push_back(Point3f(j*squareSize, i*squareSize, 0));
+    return pts;
+}
+
+double median(vector<double>& v)
+{
+    std::nth_element(v.begin(), v.begin() + v.size()/2, v.end());
+    return v[v.size()/2];
+}
+
+// Per-frame blocks of the normal equations: V = Jb^t*Jb and g = Jb^t*e
+// for the board pose, W[k] = Jc^t*Jb couples it to camera k.
+struct FrameBlock
+{
+    Matx66d V, Vinv;
+    Vec6d g;
+    vector<Matx66d> W;
+};
+
+// Joint Levenberg-Marquardt refinement of the camera poses (camera 0 stays
+// fixed) and the board poses with the intrinsics held fixed.
+class RigAdjuster
+{
+public:
+    RigAdjuster(const RigObservations& _obs, const vector<Point3f>& _board, const RigCalibration& _rig,
+                const vector<int>& _frames, int _nthreads)
+        : obs(_obs), board(_board), rig(_rig), frames(_frames),
+          N(_obs.ncameras), nthreads(resolveThreadCount(_nthreads)), blocks(_frames.size())
+    {
+        npoints = 0;
+        for( size_t i = 0; i < frames.size(); i++ )
+            for( int k = 0; k < N; k++ )
+                if( obs.seen(frames[i], k) )
+                    npoints += (int)board.size();
+    }
+
+    // returns the final RMS reprojection error
+    double run(vector<Pose>& cams, vector<Pose>& boards, int maxIterations, Metrics* metrics);
+
+private:
+    double cost(const vector<Pose>& cams, const vector<Pose>& boards) const;
+    void linearize(const vector<Pose>& cams, const vector<Pose>& boards,
+                   vector<Matx66d>& U, vector<Vec6d>& gc);
+    bool step(const vector<Matx66d>& U, const vector<Vec6d>& gc, double lambda,
+              vector<Pose>& dcams, vector<Pose>& dboards);
+
+    const RigObservations& obs;
+    const vector<Point3f>& board;
+    const RigCalibration& rig;
+    const vector<int>& frames;
+    int N, nthreads, npoints;
+    vector<FrameBlock> blocks;
+};
+
+double RigAdjuster::cost(const vector<Pose>& cams, const vector<Pose>& boards) const
+{
+    vector<double> sums(nthreads, 0.);
+    parallelFor((int)frames.size(), nthreads, [&](int i, int tid)
+    {
+        vector<Point2f> proj;
+        for( int k = 0; k < N; k++ )
+        {
+            if( !obs.seen(frames[i], k) )
+                continue;
+            Pose p = k == 0 ? boards[i] : compose(boards[i], cams[k]);
+            projectPoints(board, rot(p), trans(p), rig.cameraMatrix[k], rig.distCoeffs[k], proj);
+            const vector<Point2f>& corners = obs.corners[frames[i]*N + k];
+            for( size_t j = 0; j < proj.size(); j++ )
+            {
+                Point2f d = corners[j] - proj[j];
+                sums[tid] += (double)d.x*d.x + (double)d.y*d.y;
+            }
+        }
+    });
+    double s = 0;
+    for( int t = 0; t < nthreads; t++ )
+        s += sums[t];
+    return s;
+}
+
+void RigAdjuster::linearize(const vector<Pose>& cams, const vector<Pose>& boards,
+                            vector<Matx66d>& U, vector<Vec6d>& gc)
+{
+    // the camera blocks are summed per thread and merged afterwards
+    vector<vector<Matx66d> > tU(nthreads, vector<Matx66d>(N, Matx66d::zeros()));
+    vector<vector<Vec6d> > tg(nthreads, vector<Vec6d>(N, Vec6d::all(0)));
+    parallelFor((int)frames.size(), nthreads, [&](int i, int tid)
+    {
+        FrameBlock& fb = blocks[i];
+        fb.V = Matx66d::zeros();
+        fb.g = Vec6d::all(0);
+        fb.W.assign(N, Matx66d::zeros());
+        vector<Point2f> proj;
+        Mat J, r3, t3, dr3dr1, dr3dt1, dr3dr2, dr3dt2, dt3dr1, dt3dt1, dt3dr2, dt3dt2;
+        for( int k = 0; k < N; k++ )
+        {
+            if( !obs.seen(frames[i], k) )
+                continue;
+            Matx66d A1 = Matx66d::eye(), A2;
+            if( k == 0 )
+            {
+                r3 = Mat(rot(boards[i]));
+                t3 = Mat(trans(boards[i]));
+            }
+            else
+            {
+                composeRT(rot(boards[i]), trans(boards[i]), rot(cams[k]), trans(cams[k]), r3, t3,
+                          dr3dr1, dr3dt1, dr3dr2, dr3dt2, dt3dr1, dt3dt1, dt3dr2, dt3dt2);
+                A1 = chain(dr3dr1, dr3dt1, dt3dr1, dt3dt1);
+                A2 = chain(dr3dr2, dr3dt2, dt3dr2, dt3dt2);
+            }
+            projectPoints(board, r3, t3, rig.cameraMatrix[k], rig.distCoeffs[k], proj, J);
+            J.convertTo(J, CV_64F);
+            const vector<Point2f>& corners = obs.corners[frames[i]*N + k];
+            for( size_t j = 0; j < proj.size(); j++ )
+                for( int c = 0; c < 2; c++ )
+                {
+                    double e = c == 0 ? corners[j].x - proj[j].x : corners[j].y - proj[j].y;
+                    const double* Jp = J.ptr<double>((int)j*2 + c);
+                    Matx16d row(Jp[0], Jp[1], Jp[2], Jp[3], Jp[4], Jp[5]);
+                    Vec6d jb = Vec6d((row*A1).val);
+                    fb.V += jb*jb.t();
+                    fb.g += jb*e;
+                    if( k > 0 )
+                    {
+                        Vec6d jc = Vec6d((row*A2).val);
+                        fb.W[k] += jc*jb.t();
+                        tU[tid][k] += jc*jc.t();
+                        tg[tid][k] += jc*e;
+                    }
+                }
+        }
+    });
+    U.assign(N, Matx66d::zeros());
+    gc.assign(N, Vec6d::all(0));
+    for( int t = 0; t < nthreads; t++ )
+        for( int k = 1; k < N; k++ )
+        {
+            U[k] += tU[t][k];
+            gc[k] += tg[t][k];
+        }
+}
+
+bool RigAdjuster::step(const vector<Matx66d>& U, const vector<Vec6d>& gc, double lambda,
+                       vector<Pose>& dcams, vector<Pose>& dboards)
+{
+    int nc = 6*(N - 1);
+    // reduced camera system S*dc = rhs, S = U - sum W*V^-1*W^t, summed per thread
+    vector<Mat> tS(nthreads), trhs(nthreads);
+    for( int t = 0; t < nthreads; t++ )
+    {
+        tS[t] = Mat::zeros(nc, nc, CV_64F);
+        trhs[t] = Mat::zeros(nc, 1, CV_64F);
+    }
+    parallelFor((int)frames.size(), nthreads, [&](int i, int tid)
+    {
+        FrameBlock& fb = blocks[i];
+        Matx66d V = fb.V;
+        for( int a = 0; a < 6; a++ )
+            V(a, a) *= 1 + lambda;
+        fb.Vinv = V.inv(DECOMP_CHOLESKY);
+        Mat& S = tS[tid];
+        Mat& rhs = trhs[tid];
+        for( int a = 1; a < N; a++ )
+        {
+            if( !obs.seen(frames[i], a) )
+                continue;
+            Matx66d WV = fb.W[a]*fb.Vinv;
+            Vec6d r = WV*fb.g;
+            for( int u = 0; u < 6; u++ )
+                rhs.at<double>((a - 1)*6 + u) -= r[u];
+            for( int b = 1; b < N; b++ )
+            {
+                if( !obs.seen(frames[i], b) )
+                    continue;
+                Matx66d blk = WV*fb.W[b].t();
+                for( int u = 0; u < 6; u++ )
+                    for( int v = 0; v < 6; v++ )
+                        S.at<double>((a - 1)*6 + u, (b - 1)*6 + v) -= blk(u, v);
+            }
+        }
+    });
+    Mat S = Mat::zeros(nc, nc, CV_64F), rhs = Mat::zeros(nc, 1, CV_64F);
+    for( int t = 0; t < nthreads; t++ )
+    {
+        S += tS[t];
+        rhs += trhs[t];
+    }
+    for( int k = 1; k < N; k++ )
+        for( int u = 0; u < 6; u++ )
+        {
+            rhs.at<double>((k - 1)*6 + u) += gc[k][u];
+            for( int v = 0; v < 6; v++ )
+                S.at<double>((k - 1)*6 + u, (k - 1)*6 + v) += U[k](u, v)*(u == v ? 1 + lambda : 1);
+        }
+
+    Mat dc;
+    if( !solve(S, rhs, dc, DECOMP_CHOLESKY) && !solve(S, rhs, dc, DECOMP_SVD) )
+        return false;
+    dcams.assign(N, Pose::all(0));
+    for( int k = 1; k < N; k++ )
+        for( int u = 0; u < 6; u++ )
+            dcams[k][u] = dc.at<double>((k - 1)*6 + u);
+
+    // back-substitution of the board poses
+    dboards.resize(frames.size());
+    parallelFor((int)frames.size(), nthreads, [&](int i, int)
+    {
+        const FrameBlock& fb = blocks[i];
+        Vec6d r = fb.g;
+        for( int k = 1; k < N; k++ )
+            if( obs.seen(frames[i], k) )
+                r -= fb.W[k].t()*dcams[k];
+        dboards[i] = fb.Vinv*r;
+    });
+    return true;
+}
+
+double RigAdjuster::run(vector<Pose>& cams, vector<Pose>& boards, int maxIterations, Metrics* metrics)
+{
+    double err = cost(cams, boards);
+    double lambda = 1e-3;
+    vector<Matx66d> U;
+    vector<Vec6d> gc;
+    vector<Pose> dcams, dboards, newCams, newBoards;
+    for( int iter = 0; iter < maxIterations; iter++ )
+    {
+        StageTimer timer(metrics, "rigAdjust", iter);
+        linearize(cams, boards, U, gc);
+        bool improved = false, converged = false;
+        // raise the damping until a step lowers the error
+        for( int attempt = 0; attempt < 10 && !improved; attempt++ )
+        {
+            if( step(U, gc, lambda, dcams, dboards) )
+            {
+                newCams = cams;
+                newBoards = boards;
+                double dnorm = 0, pnorm = 0;
+                for( int k = 1; k < N; k++ )
+                {
+                    newCams[k] += dcams[k];
+                    dnorm += dcams[k].dot(dcams[k]);
+                    pnorm += cams[k].dot(cams[k]);
+                }
+                for( size_t i = 0; i < boards.size(); i++ )
+                {
+                    newBoards[i] += dboards[i];
+                    dnorm += dboards[i].dot(dboards[i]);
+                    pnorm += boards[i].dot(boards[i]);
+                }
+                double newErr = cost(newCams, newBoards);
+                if( newErr < err )
+                {
+                    converged = err - newErr < 1e-10*err || sqrt(dnorm) < 1e-10*(sqrt(pnorm) + 1e-10);
+                    err = newErr;
+                    cams.swap(newCams);
+                    boards.swap(newBoards);
+                    lambda = std::max(lambda*0.1, 1e-12);
+                    improved = true;
+                    continue;
+                }
+            }
+            lambda *= 10;
+        }
+        if( !improved || converged )
+            break;
+    }
+    return npoints > 0 ? sqrt(err/npoints) : 0.;
+}
+}
+
+bool RigCalibration::save(const string& filename) const
+{
+    FileStorage fs(filename, FileStorage::WRITE);
+    if( !fs.isOpened() )
+        return false;
+    fs << "cameraCount" << ncameras() << "rms" << rms << "frames" << nframes;
+    fs << "cameras" << "[";
+    for( int k = 0; k < ncameras(); k++ )
+        fs << "{" << "imageSize" << imageSize[k] << "M" << cameraMatrix[k] << "D" << distCoeffs[k]
+           << "R" << R[k] << "T" << T[k] << "rms" << intrinsicRms[k] << "views" << intrinsicViews[k] << "}";
+    fs << "]";
+    return true;
+}
+
+bool RigCalibration::load(const string& filename)
+{
+    FileStorage fs(filename, FileStorage::READ);
+    if( !fs.isOpened() )
+        return false;
+    FileNode cams = fs["cameras"];
+    if( cams.type() != FileNode::SEQ )
+        return false;
+    int n = (int)cams.size();
+    imageSize.resize(n);
+    cameraMatrix.resize(n);
+    distCoeffs.resize(n);
+    R.resize(n);
+    T.resize(n);
+    intrinsicRms.resize(n);
+    intrinsicViews.resize(n);
+    fs["rms"] >> rms;
+    fs["frames"] >> nframes;
+    for( int k = 0; k < n; k++ )
+    {
+        FileNode c = cams[k];
+        c["imageSize"] >> imageSize[k];
+        c["M"] >> cameraMatrix[k];
+        c["D"] >> distCoeffs[k];
+        c["R"] >> R[k];
+        c["T"] >> T[k];
+        c["rms"] >> intrinsicRms[k];
+        c["views"] >> intrinsicViews[k];
+        if( cameraMatrix[k].empty() || R[k].empty() || T[k].empty() )
+            return false;
+    }
+    return true;
+}
+
+bool detectRigCorners(const vector<string>& imagelist, int ncameras, Size boardSize,
+                      const RigCalibOptions& opts, RigObservations& obs)
+{
+    if( ncameras <= 0 || imagelist.size() % ncameras != 0 )
+    {
+        cout << "Error: the image list does not split into frames of " << ncameras << " images\n";
+        return false;
+    }
+    int nimages = (int)imagelist.size();
+    int nworkers = resolveThreadCount(opts.nthreads);
+    obs.ncameras = ncameras;
+    obs.nframes = nimages/ncameras;
+    obs.corners.assign(nimages, vector<Point2f>());
+    vector<Size> sizes(nimages);
+
+    // images detected by an earlier run are taken from the corner cache
+    CornerCache cornerCache(opts.cornerCacheDir);
+    uint64_t detectorConfig = CornerCache::configKey(boardSize,
+        CALIB_CB_ADAPTIVE_THRESH | CALIB_CB_NORMALIZE_IMAGE, MAX_SCALE, opts.coarseSize);
+    vector<uint64_t> fileKeys(nimages, 0);
+    vector<uchar> keyed(nimages, 0), cached(nimages, 0);
+    if( cornerCache.enabled() )
+        parallelFor(nimages, nworkers, [&](int i, int)
+        {
+            CachedCorners entry;
+            keyed[i] = CornerCache::fileKey(imagelist[i], detectorConfig, fileKeys[i]);
+            if( keyed[i] && cornerCache.load(fileKeys[i], entry) )
+            {
+                cached[i] = 1;
+                sizes[i] = entry.imageSize;
+                if( entry.found )
+                    obs.corners[i].swap(entry.corners);
+            }
+        });
+
+    vector<int> todo;
+    vector<string> todoFiles;
+    for( int i = 0; i < nimages; i++ )
+        if( !cached[i] )
+        {
+            todo.push_back(i);
+            todoFiles.push_back(imagelist[i]);
+        }
+    ImagePrefetcher loader(todoFiles, 0,
+                           opts.decoders > 0 ? opts.decoders : std::max(1, nworkers/2),
+                           opts.prefetch > 0 ? opts.prefetch : 4*nworkers,
+                           (size_t)opts.prefetchBudgetMB << 20, opts.metrics);
+    parallelFor((int)todo.size(), nworkers, [&](int q, int)
+    {
+        int i = todo[q];
+        Mat img = loader.take(q);
+        if( img.empty() )
+            return;
+        sizes[i] = img.size();
+        if( opts.prefilter && !mayContainBoard(img, boardSize, PrefilterParams(), opts.metrics, i) )
+            return;
+        bool found = opts.coarseSize > 0 ?
+            findBoardCornersPyramid(img, boardSize, obs.corners[i], opts.coarseSize, MAX_SCALE, opts.metrics, i) :
+            findBoardCorners(img, boardSize, obs.corners[i], MAX_SCALE, opts.metrics, i);
+        if( keyed[i] )
+        {
+            CachedCorners entry;
+            entry.found = found;
+            entry.imageSize = sizes[i];
+            entry.corners = obs.corners[i];
+            cornerCache.store(fileKeys[i], entry);
+        }
+        if( !found )
+            obs.corners[i].clear();
+    });
+
+    obs.imageSize.assign(ncameras, Size());
+    for( int i = 0; i < nimages; i++ )
+    {
+        int k = i % ncameras;
+        if( sizes[i] == Size() )
+        {
+            cout << "Error: can not read " << imagelist[i] << ", skipping it\n";
+            continue;
+        }
+        if( obs.imageSize[k] == Size() )
+            obs.imageSize[k] = sizes[i];
+        else if( sizes[i] != obs.imageSize[k] )
+        {
+            cout << "Error: " << imagelist[i] << " differs in size from the other images of camera " << k << "\n";
+            return false;
+        }
+    }
+    if( cornerCache.enabled() )
+        cout << nimages - (int)todo.size() << " of " << nimages << " images taken from the corner cache\n";
+    cout << "Image loading: " << loader.decodeSeconds() << " s decoding, detectors stalled "
+         << loader.stallSeconds() << " s on I/O\n";
+    return true;
+}
+
+bool calibrateRig(const RigObservations& obs, Size boardSize, const RigCalibOptions& opts, RigCalibration& rig)
+{
+    int N = obs.ncameras, nframes = obs.nframes;
+    vector<Point3f> board = boardPoints(boardSize, opts.squareSize);
+    rig.imageSize = obs.imageSize;
+    rig.cameraMatrix.assign(N, Mat());
+    rig.distCoeffs.assign(N, Mat());
+    rig.R.assign(N, Mat());
+    rig.T.assign(N, Mat());
+    rig.intrinsicRms.assign(N, 0.);
+    rig.intrinsicViews.assign(N, 0);
+    rig.rms = 0;
+    rig.nframes = 0;
+
+    // INTRINSICS, all cameras at once
+    vector<uchar> calibrated(N, 0);
+    parallelFor(N, opts.nthreads, [&](int k, int)
+    {
+        StageTimer timer(opts.metrics, "calibrateCamera", k);
+        ViewSelector selector(boardSize, opts.maxViews);
+        for( int f = 0; f < nframes && !selector.full(); f++ )
+            if( obs.seen(f, k) )
+                selector.offer(obs.corners[f*N + k], obs.imageSize[k]);
+        if( selector.size() < MIN_INTRINSIC_VIEWS )
+            return;
+        vector<vector<Point3f> > objectPoints(selector.size(), board);
+        vector<Mat> rvecs, tvecs;
+        Mat K = Mat::eye(3, 3, CV_64F), D;
+        rig.intrinsicRms[k] = calibrateCamera(objectPoints, selector.views(), obs.imageSize[k],
+                                              K, D, rvecs, tvecs, opts.flags);
+        rig.cameraMatrix[k] = K;
+        rig.distCoeffs[k] = D;
+        rig.intrinsicViews[k] = selector.size();
+        calibrated[k] = checkRange(K) && checkRange(D);
+    });
+    for( int k = 0; k < N; k++ )
+    {
+        if( !calibrated[k] )
+        {
+            cout << "Error: camera " << k << " could not be calibrated (" << rig.intrinsicViews[k]
+                 << " usable views)\n";
+            return false;
+        }
+        cout << "camera " << k << ": " << rig.intrinsicViews[k] << " views, RMS error=" << rig.intrinsicRms[k] << endl;
+    }
+
+    // BOARD POSE OF EVERY OBSERVATION
+    StageTimer initTimer(opts.metrics, "rigInit");
+    vector<Pose> observed(nframes*N);
+    parallelFor(nframes*N, opts.nthreads, [&](int i, int)
+    {
+        int k = i % N;
+        if( obs.corners[i].empty() )
+            return;
+        Mat rvec, tvec;
+        solvePnP(board, obs.corners[i], rig.cameraMatrix[k], rig.distCoeffs[k], rvec, tvec);
+        observed[i] = makePose(rvec, tvec);
+    });
+
+    // CAMERA POSES: every camera is attached to the already placed camera
+    // it shares most frames with; their relative pose is the median over
+    // those frames
+    vector<Pose> cams(N, Pose::all(0));
+    vector<uchar> placed(N, 0);
+    placed[0] = 1;
+    for( int n = 1; n < N; n++ )
+    {
+        int bestFrom = -1, bestTo = -1, bestShared = 0;
+        for( int a = 0; a < N; a++ )
+            for( int b = 0; b < N; b++ )
+            {
+                if( !placed[a] || placed[b] )
+                    continue;
+                int shared = 0;
+                for( int f = 0; f < nframes; f++ )
+                    shared += obs.seen(f, a) && obs.seen(f, b);
+                if( shared > bestShared )
+                {
+                    bestShared = shared;
+                    bestFrom = a;
+                    bestTo = b;
+                }
+            }
+        if( bestShared == 0 )
+        {
+            for( int b = 0; b < N; b++ )
+                if( !placed[b] )
+                    cout << "Error: camera " << b << " shares no frame with the cameras placed so far\n";
+            return false;
+        }
+        vector<double> parts[6];
+        for( int f = 0; f < nframes; f++ )
+            if( obs.seen(f, bestFrom) && obs.seen(f, bestTo) )
+            {
+                Pose rel = compose(inverse(observed[f*N + bestFrom]), observed[f*N + bestTo]);
+                for( int u = 0; u < 6; u++ )
+                    parts[u].push_back(rel[u]);
+            }
+        Pose rel;
+        for( int u = 0; u < 6; u++ )
+            rel[u] = median(parts[u]);
+        cams[bestTo] = compose(cams[bestFrom], rel);
+        placed[bestTo] = 1;
+    }
+
+    // frames seen by two or more cameras tie the cameras together; the
+    // board pose is started from the first camera that saw it
+    vector<int> frames;
+    vector<Pose> boards;
+    for( int f = 0; f < nframes; f++ )
+    {
+        int nseen = 0, first = -1;
+        for( int k = 0; k < N; k++ )
+            if( obs.seen(f, k) )
+            {
+                nseen++;
+                if( first < 0 )
+                    first = k;
+            }
+        if( nseen < 2 )
+            continue;
+        frames.push_back(f);
+        boards.push_back(compose(observed[f*N + first], inverse(cams[first])));
+    }
+    initTimer.stop();
+    rig.nframes = (int)frames.size();
+
+    // JOINT REFINEMENT
+    if( N > 1 && !frames.empty() )
+    {
+        cout << "Refining " << N << " cameras on " << frames.size() << " frames ...\n";
+        RigAdjuster adjuster(obs, board, rig, frames, opts.nthreads);
+        rig.rms = adjuster.run(cams, boards, opts.maxIterations, opts.metrics);
+        cout << "done with RMS error=" << rig.rms << endl;
+    }
+    for( int k = 0; k < N; k++ )
+    {
+        Rodrigues(rot(cams[k]), rig.R[k]);
+        rig.T[k] = Mat(trans(cams[k]), true);
+    }
+    return true;
+}
@@ -0,0 +1,89 @@
+#ifndef CALIB_RIG_CALIB_HPP
+#define CALIB_RIG_CALIB_HPP
+
+#include "opencv2/core/core.hpp"
+
+#include <string>
+#include <vector>
+
+class Metrics;
+
+// Settings of the rig calibration.
+struct RigCalibOptions
+{
+    RigCalibOptions() : nthreads(0), prefetch(0), decoders(0), prefetchBudgetMB(256), coarseSize(0),
+        prefilter(false), squareSize(1.f), flags(0), maxViews(60), maxIterations(50), metrics(0) {}
+    int nthreads;          // worker threads, 0 = one per core
+    int prefetch;          // images decoded ahead of the detectors, 0 = 4 per worker
+    int decoders;          // background image decoding threads, 0 = one per two workers
+    int prefetchBudgetMB;  // upper bound for memory held by prefetched images
+    int coarseSize;        // > 0: coarse-to-fine detection starting at this image size
+    bool prefilter;        // skip detection on blurred or board-less images (see mayContainBoard)
+    std::string cornerCacheDir; // persistent corner cache, empty = disabled
+    float squareSize;      // board square size, sets the unit of the translations
+    int flags;             // calibrateCamera flags for the intrinsics
+    int maxViews;          // most views per camera the intrinsics are solved from (see ViewSelector)
+    int maxIterations;     // most Levenberg-Marquardt iterations of the joint solve
+    Metrics* metrics;      // per-stage timings, may be null
+};
+
+// Board corners seen by every camera of the rig in every frame.
+struct RigObservations
+{
+    RigObservations() : ncameras(0), nframes(0) {}
+    int ncameras, nframes;
+    std::vector<cv::Size> imageSize;                  // per camera
+    std::vector<std::vector<cv::Point2f> > corners;   // frame*ncameras + camera, empty if not found
+
+    bool seen(int frame, int camera) const { return !corners[frame*ncameras + camera].empty(); }
+};
+
+// Calibration of a rig of synchronized cameras. Camera 0 is the reference:
+// a point x in its coordinates is R[k]*x + T[k] in the coordinates of
+// camera k, the same convention as R and T of stereoCalibrate.
+struct RigCalibration
+{
+    RigCalibration() : rms(0), nframes(0) {}
+    int ncameras() const { return (int)cameraMatrix.size(); }
+
+    std::vector<cv::Size> imageSize;
+    std::vector<cv::Mat> cameraMatrix, distCoeffs;
+    std::vector<cv::Mat> R, T;
+    std::vector<double> intrinsicRms;   // as reported by calibrateCamera
+    std::vector<int> intrinsicViews;    // views the intrinsics were solved from
+    double rms;                         // reprojection error of the joint solve
+    int nframes;                        // frames in the joint solve
+
+    bool save(const std::string& filename) const;
+    bool load(const std::string& filename);
+};
+
+// Detects the board in a list of frames of ncameras images each (camera 0,
+// camera 1, ..., camera 0 of the next frame, ...). The images are decoded
+// by an ImagePrefetcher and handed to nthreads detectors one by one, so
+// the cameras are processed concurrently and long lists stream through in
+// bounded memory. Returns false if the list does not split into frames or
+// a camera has images of different sizes.
+bool detectRigCorners(const std::vector<std::string>& imagelist, int ncameras, cv::Size boardSize,
+                      const RigCalibOptions& opts, RigObservations& obs);
+
+// Calibrates the rig from the detected corners.
+//
+// The intrinsics of all cameras are solved concurrently, each from at most
+// maxViews views picked by a ViewSelector, so the cost does not grow with
+// the length of the recording. The board pose of every observation is then
+// found with solvePnP, the cameras are chained to the reference camera
+// along the pairs sharing the most frames, and finally the poses of all
+// cameras and of the board in every frame seen by two or more cameras are
+// refined together, minimizing the reprojection error of all observations
+// with Levenberg-Marquardt. In the normal equations every board pose only
+// couples to the cameras that saw it, so the board poses are eliminated
+// frame by frame (Schur complement) and only a 6(ncameras-1) square system
+// is solved; building it runs in parallel over the frames, so an iteration
+// costs time linear in the number of frames.
+// Returns false if a camera could not be calibrated or is not connected to
+// the reference camera through shared frames.
+bool calibrateRig(const RigObservations& obs, cv::Size boardSize,
+                  const RigCalibOptions& opts, RigCalibration& rig);
+
+#endif
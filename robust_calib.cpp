@@ -0,0 +1,138 @@
+#include "robust_calib.hpp"
+#include "calib_errors.hpp"
+#include "metrics.hpp"
+
+#include "opencv2/calib3d/calib3d.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+using namespace cv;
+using namespace std;
+
+namespace
+{
+// fewest views a solve is attempted with
+const int MIN_VIEWS = 2;
+
+double solveStereo(const vector<vector<Point3f> >& objectPoints, const vector<vector<Point2f> >* imagePoints,
+                   Mat* cameraMatrix, Mat* distCoeffs, Size imageSize,
+                   Mat& R, Mat& T, Mat& E, Mat& F, int flags, TermCriteria criteria)
+{
+    // OpenCV 3 swapped the criteria and flags arguments
+#if CV_MAJOR_VERSION >= 3
+    return stereoCalibrate(objectPoints, imagePoints[0], imagePoints[1],
+                           cameraMatrix[0], distCoeffs[0], cameraMatrix[1], distCoeffs[1],
+                           imageSize, R, T, E, F, flags, criteria);
+#else
+    return stereoCalibrate(objectPoints, imagePoints[0], imagePoints[1],
+                           cameraMatrix[0], distCoeffs[0], cameraMatrix[1], distCoeffs[1],
+                           imageSize, R, T, E, F, criteria, flags);
+#endif
+}
+
+// Views to drop after a solve, worst first.
+vector<int> findOutliers(const vector<float>& viewErrors, const OutlierRejection& rejection)
+{
+    vector<int> outliers;
+    int n = (int)viewErrors.size();
+    if( rejection.factor <= 0 || n <= MIN_VIEWS )
+        return outliers;
+
+    vector<float> sorted(viewErrors);
+    std::nth_element(sorted.begin(), sorted.begin() + n/2, sorted.end());
+    double threshold = std::max(rejection.factor*sorted[n/2], rejection.minError);
+
+    vector<pair<float, int> > candidates;
+    for( int i = 0; i < n; i++ )
+        if( viewErrors[i] > threshold )
+            candidates.push_back(make_pair(viewErrors[i], i));
+    std::sort(candidates.begin(), candidates.end(), greater<pair<float, int> >());
+
+    int maxDrop = std::min(std::max(cvFloor(rejection.maxDropFraction*n), 1), n - MIN_VIEWS);
+    for( int i = 0; i < (int)candidates.size() && i < maxDrop; i++ )
+        outliers.push_back(candidates[i].second);
+    return outliers;
+}
+}
+
+double robustStereoCalibrate(vector<vector<Point3f> >& objectPoints, vector<vector<Point2f> >* imagePoints,
+                             Mat* cameraMatrix, Mat* distCoeffs, Size imageSize,
+                             Mat& R, Mat& T, Mat& E, Mat& F, int flags, TermCriteria criteria,
+                             const OutlierRejection& rejection, vector<int>& kept,
+                             vector<StereoRound>* rounds, CalibErrors* epipolar,
+                             Metrics* metrics, int nthreads)
+{
+    int nviews = (int)objectPoints.size();
+    CV_Assert( (int)imagePoints[0].size() == nviews && (int)imagePoints[1].size() == nviews );
+    kept.resize(nviews);
+    for( int i = 0; i < nviews; i++ )
+        kept[i] = i;
+    if( rounds )
+        rounds->clear();
+
+    CalibErrors errors;
+    double rms = 0;
+    for( int round = 0; ; round++ )
+    {
+        int64 t0 = getTickCount();
+        StageTimer calibTimer(metrics, "stereoCalibrate", round);
+        double prevRms = rms;
+        rms = solveStereo(objectPoints, imagePoints, cameraMatrix, distCoeffs, imageSize, R, T, E, F,
+                          round > 0 ? flags | CALIB_USE_INTRINSIC_GUESS : flags, criteria);
+        calibTimer.stop();
+        StageTimer epipolarTimer(metrics, "epipolar", round);
+        double epipolarErr = epipolarErrors(imagePoints, cameraMatrix, distCoeffs, F, errors, nthreads);
+        epipolarTimer.stop();
+
+        StereoRound r;
+        r.rms = rms;
+        r.epipolarError = epipolarErr;
+        r.ms = (getTickCount() - t0)*1000./getTickFrequency();
+
+        vector<int> outliers;
+        bool converged = round > 0 && prevRms - rms < rejection.tolerance*prevRms;
+        if( round < rejection.maxRounds && !converged )
+            outliers = findOutliers(errors.viewErrors, rejection);
+        if( outliers.empty() )
+        {
+            if( rounds )
+                rounds->push_back(r);
+            break;
+        }
+
+        // drop the outliers, keeping the order of the others
+        vector<uchar> drop(objectPoints.size(), 0);
+        for( size_t i = 0; i < outliers.size(); i++ )
+        {
+            drop[outliers[i]] = 1;
+            r.dropped.push_back(kept[outliers[i]]);
+        }
+        int j = 0;
+        for( int i = 0; i < (int)objectPoints.size(); i++ )
+        {
+            if( drop[i] )
+                continue;
+            if( j < i )
+            {
+                objectPoints[j].swap(objectPoints[i]);
+                imagePoints[0][j].swap(imagePoints[0][i]);
+                imagePoints[1][j].swap(imagePoints[1][i]);
+                kept[j] = kept[i];
+            }
+            j++;
+        }
+        objectPoints.resize(j);
+        imagePoints[0].resize(j);
+        imagePoints[1].resize(j);
+        kept.resize(j);
+        if( metrics )
+            metrics->reject("outlier", (int)outliers.size());
+        if( rounds )
+            rounds->push_back(r);
+    }
+    if( epipolar )
+        std::swap(*epipolar, errors);
+    return rms;
+}
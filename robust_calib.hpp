@@ -0,0 +1,58 @@
+#ifndef CALIB_ROBUST_CALIB_HPP
+#define CALIB_ROBUST_CALIB_HPP
+
+#include "opencv2/core/core.hpp"
+
+#include <vector>
+
+struct CalibErrors;
+class Metrics;
+
+// When a view counts as an outlier and how long to keep dropping them.
+struct OutlierRejection
+{
+    OutlierRejection() : factor(3), minError(0.5), maxRounds(5), maxDropFraction(0.1), tolerance(0.01) {}
+    double factor;          // a view whose mean epipolar error exceeds factor times the median
+    double minError;        // and minError pixels is an outlier; factor <= 0 disables rejection
+    int maxRounds;          // most re-solves after the first calibration
+    double maxDropFraction; // most views dropped per round (at least one), worst first
+    double tolerance;       // stop once a re-solve lowers the RMS by less than this fraction
+};
+
+// One solve of robustStereoCalibrate.
+struct StereoRound
+{
+    StereoRound() : rms(0), epipolarError(0), ms(0) {}
+    double rms;                 // as reported by stereoCalibrate
+    double epipolarError;       // average epipolar line distance
+    double ms;                  // wall time of the solve and the residuals
+    std::vector<int> dropped;   // original indices of the views dropped after it
+};
+
+// stereoCalibrate with automatic removal of bad views.
+//
+// After every solve the mean epipolar error of each view is computed (it
+// needs no per-view poses, which stereoCalibrate does not return). Views
+// far above the median are dropped, a few at a time since one bad
+// detection also drags up the error of good views, and the remaining views
+// are solved again, starting from the previous intrinsics. The loop stops
+// when no outlier is left, the RMS no longer improves, or after maxRounds
+// re-solves; bad data then costs one or two extra solves instead of a
+// rerun by hand.
+//
+// objectPoints and imagePoints are pruned in place; kept receives the
+// original index of every remaining view. The first solve uses flags as
+// given, later ones add CALIB_USE_INTRINSIC_GUESS. epipolar, if not null,
+// receives the residuals of the final solution. Every solve is recorded
+// in metrics as a "stereoCalibrate" event (item = round) and dropped views
+// as "outlier" rejections. Returns the final RMS.
+double robustStereoCalibrate(std::vector<std::vector<cv::Point3f> >& objectPoints,
+                             std::vector<std::vector<cv::Point2f> >* imagePoints,
+                             cv::Mat* cameraMatrix, cv::Mat* distCoeffs, cv::Size imageSize,
+                             cv::Mat& R, cv::Mat& T, cv::Mat& E, cv::Mat& F,
+                             int flags, cv::TermCriteria criteria,
+                             const OutlierRejection& rejection, std::vector<int>& kept,
+                             std::vector<StereoRound>* rounds = 0, CalibErrors* epipolar = 0,
+                             Metrics* metrics = 0, int nthreads = 0);
+
+#endif
@@ -0,0 +1,554 @@
+/* This is sample from the OpenCV book. The copyright notice is below */
+
+/* *************** License:**************************
+   Oct. 3, 2008
+   Right to use this code in any way you want without warranty, support or any guarantee of it working.
+
+   BOOK: It would be nice if you cited it:
+   Learning OpenCV: Computer Vision with the OpenCV Library
+     by Gary Bradski and Adrian Kaehler
+     Published by O'Reilly Media, October 3, 2008
+
+   AVAILABLE AT:
+     http://www.amazon.com/Learning-OpenCV-Computer-Vision-Library/dp/0596516134
+     Or: http://oreilly.com/catalog/9780596516130/
+     ISBN-10: 0596516134 or: ISBN-13: 978-0596516130
+
+   OPENCV WEBSITES:
+     Homepage:      http://opencv.org
+     Online docs:   http://docs.opencv.org
+     Q&A forum:     http://answers.opencv.org
+     Issue tracker: http://code.opencv.org
+     GitHub:        https://github.com/Itseez/opencv/
+   ************************************************** */
+
+
+#include "stereo_calib.hpp"
+
+#include "opencv2/calib3d/calib3d.hpp"
+#include "opencv2/highgui/highgui.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include "calib_errors.hpp"
+#include "corner_cache.hpp"
+#include "detect.hpp"
+#include "image_cache.hpp"
+#include "image_loader.hpp"
+#include "mapped_file.hpp"
+#include "metrics.hpp"
+#include "rectified_preview.hpp"
+#include "rectify_maps.hpp"
+#include "robust_calib.hpp"
+#include "parallel.hpp"
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace cv;
+using namespace std;
+
+// Detection result of one stereo pair. The right image is only looked at
+// when the left one was loaded and its board found, as in the serial loop.
+struct PairDetection
+{
+    PairDetection() : cached(false)
+    {
+        loaded[0] = loaded[1] = found[0] = found[1] = skipped[0] = skipped[1] = false;
+        ms[0] = ms[1] = 0;
+    }
+    bool cached;           // taken from the corner cache, no detection needed
+    bool loaded[2];
+    bool found[2];
+    bool skipped[2];       // rejected by the prefilter, detection not attempted
+    double ms[2];          // detection latency
+    Size size[2];
+    vector<Point2f> corners[2];
+};
+
+bool
+StereoCalib(const vector<string>& imagelist, Size boardSize, bool useCalibrated, bool showRectified,
+            const StereoCalibOptions& opts, StereoCalibResult* result)
+{
+    if( imagelist.size() % 2 != 0 )
+    {
+        cout << "Error: the image list contains odd (non-even) number of elements\n";
+        return false;
+    }
+
+    bool displayCorners = false;//true;
+    const int maxScale = 2;
+    const float squareSize = 1.f;  // Set this to your actual square size
+    const string outputPrefix = opts.batch ? opts.outputDir + "/" : string();
+    // in batch mode the rectified pairs are written instead of shown
+    if( opts.batch )
+    {
+        if( !makeDirs(opts.outputDir) )
+        {
+            cout << "Error: can not create the output directory " << opts.outputDir << endl;
+            return false;
+        }
+        displayCorners = false;
+        showRectified = opts.writePreview;
+    }
+    Metrics metrics;
+    if( !opts.metrics && !opts.metricsFile.empty() && !metrics.open(opts.metricsFile) )
+        cout << "Error: can not open the metrics file " << opts.metricsFile << endl;
+    Metrics* mp = opts.metrics ? opts.metrics : &metrics;
+    // ARRAY AND VECTOR STORAGE:
+
+    vector<vector<Point2f> > imagePoints[2];
+    vector<vector<Point3f> > objectPoints;
+    Size imageSize;
+
+    int i, j, k, nimages = (int)imagelist.size()/2;
+
+    imagePoints[0].resize(nimages);
+    imagePoints[1].resize(nimages);
+    vector<string> goodImageList;
+
+    // Corner detection dominates the run time and the pairs are independent,
+    // so they are farmed out to worker threads. Each pair writes only its own
+    // slot; the slots are then walked in list order below, which keeps
+    // imagePoints and goodImageList identical to a sequential run.
+    int nworkers = resolveThreadCount(opts.nthreads);
+    vector<PairDetection> pairs(nimages);
+
+    // Pairs detected by an earlier run with the same detector settings are
+    // taken from the corner cache without decoding the images at all.
+    CornerCache cornerCache(opts.cornerCacheDir);
+    uint64_t detectorConfig = CornerCache::configKey(boardSize,
+        CALIB_CB_ADAPTIVE_THRESH | CALIB_CB_NORMALIZE_IMAGE, maxScale, opts.coarseSize);
+    vector<uint64_t> fileKeys(imagelist.size(), 0);
+    vector<uchar> keyed(imagelist.size(), 0);
+    if( cornerCache.enabled() )
+        parallelFor(nimages, nworkers, [&](int p, int)
+        {
+            PairDetection& pd = pairs[p];
+            for( int lr = 0; lr < 2; lr++ )
+            {
+                CachedCorners entry;
+                int idx = p*2+lr;
+                keyed[idx] = CornerCache::fileKey(imagelist[idx], detectorConfig, fileKeys[idx]);
+                if( !keyed[idx] || !cornerCache.load(fileKeys[idx], entry) )
+                {
+                    if( lr == 0 )
+                        keyed[idx+1] = CornerCache::fileKey(imagelist[idx+1], detectorConfig, fileKeys[idx+1]);
+                    pd = PairDetection();
+                    return;
+                }
+                pd.loaded[lr] = true;
+                pd.size[lr] = entry.imageSize;
+                pd.found[lr] = entry.found;
+                pd.corners[lr].swap(entry.corners);
+                if( !pd.found[lr] )
+                    break;
+            }
+            pd.cached = true;
+        });
+
+    vector<int> todo;
+    vector<string> todoFiles;
+    for( i = 0; i < nimages; i++ )
+        if( !pairs[i].cached )
+        {
+            todo.push_back(i);
+            todoFiles.push_back(imagelist[i*2]);
+            todoFiles.push_back(imagelist[i*2+1]);
+        }
+
+    // The images are decoded ahead of the workers by the prefetcher.
+    ImagePrefetcher loader(todoFiles, 0,
+                           opts.decoders > 0 ? opts.decoders : std::max(1, nworkers/2),
+                           opts.prefetch > 0 ? opts.prefetch : 4*nworkers,
+                           (size_t)opts.prefetchBudgetMB << 20, mp);
+    // decoded images of good pairs are kept for the rectification pass
+    ImageCache imageCache(showRectified ? (size_t)opts.cacheBudgetMB << 20 : 0);
+    vector<double> detectTime(nworkers, 0.);
+    parallelFor((int)todo.size(), nworkers, [&](int q, int tid)
+    {
+        int p = todo[q];
+        PairDetection& pd = pairs[p];
+        // both images are taken even if the left one fails, so the
+        // prefetch window keeps moving
+        Mat views[2] = { loader.take(q*2), loader.take(q*2+1) };
+        int64 t0 = getTickCount();
+        for( int lr = 0; lr < 2; lr++ )
+        {
+            const Mat& img = views[lr];
+            if( img.empty() )
+                break;
+            pd.loaded[lr] = true;
+            pd.size[lr] = img.size();
+            int64 t1 = getTickCount();
+            if( opts.prefilter && !mayContainBoard(img, boardSize, PrefilterParams(), mp, p*2+lr) )
+            {
+                pd.skipped[lr] = true;
+                pd.ms[lr] = (getTickCount() - t1)*1000./getTickFrequency();
+                break;
+            }
+            pd.found[lr] = opts.coarseSize > 0 ?
+                findBoardCornersPyramid(img, boardSize, pd.corners[lr], opts.coarseSize, maxScale, mp, p*2+lr) :
+                findBoardCorners(img, boardSize, pd.corners[lr], maxScale, mp, p*2+lr);
+            pd.ms[lr] = (getTickCount() - t1)*1000./getTickFrequency();
+            if( !pd.found[lr] )
+                break;
+        }
+        if( pd.found[0] && pd.found[1] )
+            for( int lr = 0; lr < 2; lr++ )
+                imageCache.put(imagelist[p*2+lr], views[lr]);
+        detectTime[tid] += (getTickCount() - t0)/getTickFrequency();
+
+        // a prefilter verdict is not a detection result, so it is not cached
+        for( int lr = 0; lr < 2 && pd.loaded[lr] && !pd.skipped[lr]; lr++ )
+            if( keyed[p*2+lr] )
+            {
+                CachedCorners entry;
+                entry.found = pd.found[lr];
+                entry.imageSize = pd.size[lr];
+                entry.corners = pd.corners[lr];
+                cornerCache.store(fileKeys[p*2+lr], entry);
+            }
+    });
+
+    double detectTotal = 0;
+    for( i = 0; i < nworkers; i++ )
+        detectTotal += detectTime[i];
+    cout << "Image loading: " << loader.decodeSeconds() << " s decoding, detectors stalled "
+         << loader.stallSeconds() << " s on I/O vs " << detectTotal << " s computing (peak "
+         << (loader.peakBytes() >> 20) << " MB buffered)\n";
+    if( cornerCache.enabled() )
+        cout << nimages - (int)todo.size() << " of " << nimages << " pairs taken from the corner cache\n";
+    if( opts.prefilter )
+    {
+        // what a skipped image would have cost is estimated from the
+        // images that passed the prefilter but had no board after all
+        int nskipped = 0, nfailed = 0;
+        double failedMs = 0;
+        for( i = 0; i < nimages; i++ )
+            for( k = 0; k < 2; k++ )
+            {
+                const PairDetection& pd = pairs[i];
+                if( pd.cached || !pd.loaded[k] )
+                    continue;
+                if( pd.skipped[k] )
+                    nskipped++;
+                else if( !pd.found[k] )
+                {
+                    nfailed++;
+                    failedMs += pd.ms[k];
+                }
+            }
+        cout << "The prefilter skipped " << nskipped << " images";
+        if( nskipped > 0 && nfailed > 0 )
+        {
+            double savedMs = nskipped*failedMs/nfailed;
+            cout << ", saving about " << savedMs << " ms of detection";
+            mp->record("prefilterSaved", savedMs, savedMs);
+        }
+        cout << "\n";
+    }
+
+    for( i = j = 0; i < nimages; i++ )
+    {
+        const PairDetection& pd = pairs[i];
+        for( k = 0; k < 2; k++ )
+        {
+            const string& filename = imagelist[i*2+k];
+
+            if( !opts.batch )
+            {
+                std::cout << "filename: " << filename;
+                if( !pd.loaded[k] )
+                    std::cout << std::endl;
+                else if( pd.cached )
+                    std::cout << " (cached)" << std::endl;
+                else if( pd.skipped[k] )
+                    std::cout << " (skipped by the prefilter)" << std::endl;
+                else
+                    std::cout << " (detection " << pd.ms[k] << " ms)" << std::endl;
+            }
+
+            if( !pd.loaded[k] )
+            {
+                mp->reject("load");
+                break;
+            }
+            if( imageSize == Size() )
+                imageSize = pd.size[k];
+            else if( pd.size[k] != imageSize )
+            {
+                cout << "The image " << filename << " has the size different from the first image size. Skipping the pair\n";
+                mp->reject("size");
+                break;
+            }
+            if( displayCorners )
+            {
+                cout << filename << endl;
+                Mat img = imread(filename, 0), cimg, cimg1;
+                cvtColor(img, cimg, COLOR_GRAY2BGR);
+                drawChessboardCorners(cimg, boardSize, pd.corners[k], pd.found[k]);
+                double sf = 640./MAX(img.rows, img.cols);
+                resize(cimg, cimg1, Size(), sf, sf);
+                imshow("corners", cimg1);
+                char c = (char)waitKey(500);
+                if( c == 27 || c == 'q' || c == 'Q' ) //Allow ESC to quit
+                    exit(-1);
+            }
+            else if( !opts.batch )
+                putchar('.');
+            if( !pd.found[k] )
+            {
+                mp->reject("detect");
+                break;
+            }
+            imagePoints[k][j] = pd.corners[k];
+        }
+        if( k == 2 )
+        {
+            goodImageList.push_back(imagelist[i*2]);
+            goodImageList.push_back(imagelist[i*2+1]);
+            j++;
+        }
+    }
+    cout << j << " pairs have been successfully detected.\n";
+    nimages = j;
+    if( nimages < 2 )
+    {
+        cout << "Error: too little pairs to run the calibration\n";
+        return false;
+    }
+
+    imagePoints[0].resize(nimages);
+    imagePoints[1].resize(nimages);
+    objectPoints.resize(nimages);
+
+    for( i = 0; i < nimages; i++ )
+    {
+        for( j = 0; j < boardSize.height; j++ )
+            for( k = 0; k < boardSize.width; k++ )
+                objectPoints[i].push_back(Point3f(j*squareSize, k*squareSize, 0));
+    }
+
+    cout << "Running stereo calibration ...\n";
+
+    Mat cameraMatrix[2], distCoeffs[2];
+    cameraMatrix[0] = Mat::eye(3, 3, CV_64F);
+    cameraMatrix[1] = Mat::eye(3, 3, CV_64F);
+    Mat R, T, E, F;
+
+    const TermCriteria calibCriteria(TermCriteria::COUNT+TermCriteria::EPS, 100, 1e-5);
+    const int calibFlags = CALIB_FIX_ASPECT_RATIO +
+                    CALIB_ZERO_TANGENT_DIST +
+                    CALIB_SAME_FOCAL_LENGTH +
+                    CALIB_RATIONAL_MODEL +
+                    CALIB_FIX_K3 + CALIB_FIX_K4 + CALIB_FIX_K5;
+    vector<int> kept;
+    vector<StereoRound> rounds;
+    CalibErrors epipolar;
+    double rms = robustStereoCalibrate(objectPoints, imagePoints, cameraMatrix, distCoeffs, imageSize,
+                                       R, T, E, F, calibFlags, calibCriteria, opts.outliers, kept,
+                                       &rounds, &epipolar, mp, opts.nthreads);
+    int npairs = nimages;
+    for( size_t r = 0; r < rounds.size(); r++ )
+    {
+        cout << "done with RMS error=" << rounds[r].rms << " (" << rounds[r].ms << " ms)" << endl;
+        for( size_t d = 0; d < rounds[r].dropped.size(); d++ )
+        {
+            int v = rounds[r].dropped[d];
+            cout << "dropped the outlier pair " << goodImageList[v*2] << ", " << goodImageList[v*2+1] << endl;
+        }
+        npairs -= (int)rounds[r].dropped.size();
+        if( !rounds[r].dropped.empty() )
+            cout << "Re-running stereo calibration on " << npairs << " pairs ...\n";
+    }
+    // the rest of the run works on the kept pairs only
+    if( (int)kept.size() < nimages )
+    {
+        for( i = 0; i < (int)kept.size(); i++ )
+        {
+            goodImageList[i*2] = goodImageList[kept[i]*2];
+            goodImageList[i*2+1] = goodImageList[kept[i]*2+1];
+        }
+        nimages = (int)kept.size();
+        goodImageList.resize(nimages*2);
+    }
+
+// CALIBRATION QUALITY CHECK
+// because the output fundamental matrix implicitly
+// includes all the output information,
+// we can check the quality of calibration using the
+// epipolar geometry constraint: m2^t*F*m1=0
+// (computed for every solve above, it is also what finds the outliers)
+    double epipolarErr = epipolar.total;
+    cout << "average reprojection err = " <<  epipolarErr << endl;
+
+    if( result )
+    {
+        result->npairs = nimages;
+        result->imageSize = imageSize;
+        result->rms = rms;
+        result->epipolarError = epipolarErr;
+        for( k = 0; k < 2; k++ )
+        {
+            result->cameraMatrix[k] = cameraMatrix[k].clone();
+            result->distCoeffs[k] = distCoeffs[k].clone();
+        }
+        result->R = R.clone();
+        result->T = T.clone();
+        result->E = E.clone();
+        result->F = F.clone();
+        result->goodImageList = goodImageList;
+    }
+
+    // save intrinsic parameters
+    FileStorage fs(outputPrefix + "intrinsics.yml", FileStorage::WRITE);
+    if( fs.isOpened() )
+    {
+        fs << "M1" << cameraMatrix[0] << "D1" << distCoeffs[0] <<
+            "M2" << cameraMatrix[1] << "D2" << distCoeffs[1];
+        fs.release();
+    }
+    else
+        cout << "Error: can not save the intrinsic parameters\n";
+
+    Mat R1, R2, P1, P2, Q;
+    Rect validRoi[2];
+
+    StageTimer rectifyTimer(mp, "stereoRectify");
+    stereoRectify(cameraMatrix[0], distCoeffs[0],
+                  cameraMatrix[1], distCoeffs[1],
+                  imageSize, R, T, R1, R2, P1, P2, Q,
+                  CALIB_ZERO_DISPARITY, 1, imageSize, &validRoi[0], &validRoi[1]);
+    rectifyTimer.stop();
+
+    fs.open(outputPrefix + "extrinsics.yml", FileStorage::WRITE);
+    if( fs.isOpened() )
+    {
+        fs << "R" << R << "T" << T << "R1" << R1 << "R2" << R2 << "P1" << P1 << "P2" << P2 << "Q" << Q;
+        // the rectified areas without black borders, for tools that crop to them
+        fs << "validRoi1" << validRoi[0] << "validRoi2" << validRoi[1];
+        fs.release();
+    }
+    else
+        cout << "Error: can not save the intrinsic parameters\n";
+
+    // Bouguet rectification maps next to the extrinsics, for the tools
+    // that rectify with this calibration later
+    Mat rectR[2] = { R1, R2 }, rectP[2] = { P1, P2 };
+    RectifyMaps rmaps;
+    if( opts.saveRectifyMaps )
+    {
+        StageTimer mapTimer(mp, "initUndistortRectifyMap");
+        rmaps.loadOrCompute(outputPrefix + "rectify_maps.bin", cameraMatrix, distCoeffs, rectR, rectP, imageSize);
+    }
+
+    // OpenCV can handle left-right
+    // or up-down camera arrangements
+    bool isVerticalStereo = fabs(P2.at<double>(1, 3)) > fabs(P2.at<double>(0, 3));
+
+// COMPUTE AND DISPLAY RECTIFICATION
+    if( !showRectified )
+        return true;
+
+// IF BY CALIBRATED (BOUGUET'S METHOD)
+    if( useCalibrated )
+    {
+        // we already computed everything
+    }
+// OR ELSE HARTLEY'S METHOD
+    else
+ // use intrinsic parameters of each camera, but
+ // compute the rectification transformation directly
+ // from the fundamental matrix
+    {
+        vector<Point2f> allimgpt[2];
+        for( k = 0; k < 2; k++ )
+        {
+            for( i = 0; i < nimages; i++ )
+                std::copy(imagePoints[k][i].begin(), imagePoints[k][i].end(), back_inserter(allimgpt[k]));
+            // the fundamental matrix relates undistorted points
+            undistortPoints(allimgpt[k], allimgpt[k], cameraMatrix[k], distCoeffs[k], Mat(), cameraMatrix[k]);
+        }
+        F = findFundamentalMat(Mat(allimgpt[0]), Mat(allimgpt[1]), FM_8POINT, 0, 0);
+        Mat H1, H2;
+        stereoRectifyUncalibrated(Mat(allimgpt[0]), Mat(allimgpt[1]), F, imageSize, H1, H2, 3);
+
+        rectR[0] = cameraMatrix[0].inv()*H1*cameraMatrix[0];
+        rectR[1] = cameraMatrix[1].inv()*H2*cameraMatrix[1];
+        rectP[0] = cameraMatrix[0];
+        rectP[1] = cameraMatrix[1];
+    }
+
+    Mat canvas;
+    double sf;
+    int w, h;
+    if( !isVerticalStereo )
+    {
+        sf = 600./MAX(imageSize.width, imageSize.height);
+        w = cvRound(imageSize.width*sf);
+        h = cvRound(imageSize.height*sf);
+        canvas.create(h, w*2, CV_8UC3);
+    }
+    else
+    {
+        sf = 300./MAX(imageSize.width, imageSize.height);
+        w = cvRound(imageSize.width*sf);
+        h = cvRound(imageSize.height*sf);
+        canvas.create(h*2, w, CV_8UC3);
+    }
+
+    // the previews are rectified at canvas size, not at full resolution
+    RectifiedPreview preview;
+    {
+        StageTimer mapTimer(mp, "initUndistortRectifyMap");
+        preview.init(cameraMatrix, distCoeffs, rectR, rectP, imageSize, sf);
+    }
+
+    if( opts.batch )
+        std::cout << "writing rectified previews to " << opts.outputDir << std::endl;
+    else
+        std::cout << "show rectified images, nimages = " << nimages << std::endl;
+    for( i = 0; i < nimages; i++ )
+    {
+        for( k = 0; k < 2; k++ )
+        {
+            Mat img;
+            if( !imageCache.get(goodImageList[i*2+k], img) )
+                img = imread(goodImageList[i*2+k], 0);
+
+            Mat canvasPart = !isVerticalStereo ? canvas(Rect(w*k, 0, w, h)) : canvas(Rect(0, h*k, w, h));
+            StageTimer remapTimer(mp, "remap", i*2+k);
+            preview.render(k, img, canvasPart);
+            remapTimer.stop();
+            if( useCalibrated && !opts.batch )
+            {
+                Rect vroi(cvRound(validRoi[k].x*sf), cvRound(validRoi[k].y*sf),
+                          cvRound(validRoi[k].width*sf), cvRound(validRoi[k].height*sf));
+                rectangle(canvasPart, vroi, Scalar(0,0,255), 3, 8);
+            }
+        }
+
+        if( opts.batch )
+        {
+            imwrite(format("%srectified_%04d.png", outputPrefix.c_str(), i), canvas);
+            continue;
+        }
+
+        if( !isVerticalStereo )
+            for( j = 0; j < canvas.rows; j += 16 )
+                line(canvas, Point(0, j), Point(canvas.cols, j), Scalar(0, 255, 0), 1, 8);
+        else
+            for( j = 0; j < canvas.cols; j += 16 )
+                line(canvas, Point(j, 0), Point(j, canvas.rows), Scalar(0, 255, 0), 1, 8);
+        imshow("rectified", canvas);
+        char c = (char)waitKey();
+        if( c == 27 || c == 'q' || c == 'Q' )
+            break;
+    }
+    return true;
+}
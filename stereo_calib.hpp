@@ -0,0 +1,63 @@
+#ifndef CALIB_STEREO_CALIB_HPP
+#define CALIB_STEREO_CALIB_HPP
+
+#include "opencv2/core/core.hpp"
+#include "robust_calib.hpp"
+
+#include <string>
+#include <vector>
+
+class Metrics;
+
+// Settings of StereoCalib beyond the board and the rectification method:
+// how fast it runs (threads, prefetching, caches, coarse detection), which
+// views make it into the solve (prefilter, outliers) and what is written
+// where (batch, outputDir, writePreview, saveRectifyMaps, metrics).
+struct StereoCalibOptions
+{
+    StereoCalibOptions() : nthreads(0), prefetch(0), decoders(0), prefetchBudgetMB(256), cacheBudgetMB(1024),
+        coarseSize(0), prefilter(false), batch(false), writePreview(false), saveRectifyMaps(false), metrics(0) {}
+    int nthreads;          // detection worker threads, 0 = one per core
+    int prefetch;          // images decoded ahead of the detectors, 0 = 4 per worker
+    int decoders;          // background image decoding threads, 0 = one per two workers
+    int prefetchBudgetMB;  // upper bound for memory held by prefetched images
+    int cacheBudgetMB;     // images kept from detection for the rectification pass
+    int coarseSize;        // > 0: coarse-to-fine detection starting at this image size
+    bool prefilter;        // skip detection on blurred or board-less images (see mayContainBoard);
+                           // may drop a hard but usable image
+    std::string cornerCacheDir; // persistent corner cache, empty = disabled
+    OutlierRejection outliers;  // pairs dropped and re-solved without (see robustStereoCalibrate);
+                                // outliers.factor = 0 keeps every detected pair
+    bool batch;            // headless: no HighGUI calls, no per-image console output
+    std::string outputDir;      // batch mode: where results and previews are written
+    bool writePreview;     // batch mode: write rectified_NNNN.png previews
+    bool saveRectifyMaps;  // write rectify_maps.bin next to extrinsics.yml
+    std::string metricsFile;    // per-stage timings (JSON lines, or CSV for *.csv), empty = off
+    Metrics* metrics;      // if set, timings go here instead of to metricsFile
+};
+
+
+// What StereoCalib found; filled once the stereo calibration has run.
+struct StereoCalibResult
+{
+    StereoCalibResult() : npairs(0), rms(0), epipolarError(0) {}
+    int npairs;                         // pairs used for the calibration
+    cv::Size imageSize;
+    double rms;                         // as reported by stereoCalibrate
+    double epipolarError;               // average epipolar line distance
+    cv::Mat cameraMatrix[2], distCoeffs[2];
+    cv::Mat R, T, E, F;
+    std::vector<std::string> goodImageList;
+};
+
+// Given a list of chessboard image pairs (left, right, left, right, ...)
+// calibrates the stereo camera, saves intrinsics.yml and extrinsics.yml
+// (and optionally the rectification maps, see RectifyMaps) and optionally
+// shows (or, in batch mode, writes) the rectified pairs.
+// Returns false if there were not enough usable pairs to calibrate.
+bool StereoCalib(const std::vector<std::string>& imagelist, cv::Size boardSize,
+                 bool useCalibrated=true, bool showRectified=true,
+                 const StereoCalibOptions& opts=StereoCalibOptions(),
+                 StereoCalibResult* result=0);
+
+#endif
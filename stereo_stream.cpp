@@ -0,0 +1,318 @@
+#include "stereo_stream.hpp"
+#include "calib_file.hpp"
+#include "disparity.hpp"
+#include "frame_queue.hpp"
+#include "metrics.hpp"
+#include "rectify_maps.hpp"
+
+#include "opencv2/calib3d/calib3d.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+#include "opencv2/highgui/highgui.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace cv;
+using namespace std;
+
+namespace
+{
+struct StreamFrame
+{
+    StreamFrame() : index(0), captureTime(0) {}
+    long index;
+    double captureTime;      // seconds, getTickCount based
+    Mat raw[2], gray[2], rect[2];
+    Mat disp;
+};
+
+typedef BoundedQueue<StreamFrame*> FrameQueue;
+
+double now()
+{
+    return getTickCount()/getTickFrequency();
+}
+
+bool openSource(VideoCapture& cap, const string& source, Size frameSize, bool& isCamera)
+{
+    isCamera = !source.empty() && isdigit((unsigned char)source[0]) &&
+               source.find_first_not_of("0123456789") == string::npos;
+    if( isCamera )
+    {
+        cap.open(atoi(source.c_str()));
+        if( cap.isOpened() && frameSize.area() > 0 )
+        {
+            cap.set(CAP_PROP_FRAME_WIDTH, frameSize.width);
+            cap.set(CAP_PROP_FRAME_HEIGHT, frameSize.height);
+        }
+    }
+    else
+        cap.open(source);
+    return cap.isOpened();
+}
+
+// Hands a frame to the next stage. In drop mode a full queue gives up its
+// oldest frame, which goes back to the pool and is counted against `stage`.
+void handOver(FrameQueue& next, StreamFrame* frame, bool drop, FrameQueue& pool,
+              std::atomic<long>& dropped, Metrics* metrics, const char* stage)
+{
+    if( !drop )
+    {
+        if( !next.push(frame) )
+            pool.push(frame);
+        return;
+    }
+    StreamFrame* evicted = 0;
+    FrameQueue::PushResult r = next.pushDropOldest(frame, evicted);
+    if( r == FrameQueue::PUSHED )
+        return;
+    pool.push(evicted);
+    // frames handed over during shutdown are not counted as drops
+    if( r == FrameQueue::EVICTED )
+    {
+        dropped++;
+        metrics->reject(stage);
+    }
+}
+
+// A Rect written by FileStorage, i.e. a sequence of x, y, width, height.
+Rect readRect(const CalibFile& calib, const char* name)
+{
+    Mat v = calib.get(name);
+    if( v.total() != 4 || v.type() != CV_32S )
+        return Rect();
+    const int* r = v.ptr<int>();
+    return Rect(r[0], r[1], r[2], r[3]);
+}
+}
+
+bool runStereoStream(const StereoStreamOptions& opts, StereoStreamStats* stats)
+{
+    // YAML/XML as written by stereo_calib or the binary form of calib_convert
+    CalibFile intrinsics, extrinsics;
+    if( !intrinsics.open(opts.intrinsics) )
+    {
+        cout << "Error: can not open the intrinsic parameters " << opts.intrinsics << endl;
+        return false;
+    }
+    if( !extrinsics.open(opts.extrinsics) )
+    {
+        cout << "Error: can not open the extrinsic parameters " << opts.extrinsics << endl;
+        return false;
+    }
+    Mat M1 = intrinsics.get("M1"), D1 = intrinsics.get("D1"), M2 = intrinsics.get("M2"), D2 = intrinsics.get("D2");
+    Mat R1 = extrinsics.get("R1"), R2 = extrinsics.get("R2"), P1 = extrinsics.get("P1"), P2 = extrinsics.get("P2");
+    Rect validRoi[2] = { readRect(extrinsics, "validRoi1"), readRect(extrinsics, "validRoi2") };
+    if( M1.empty() || M2.empty() || R1.empty() || R2.empty() || P1.empty() || P2.empty() )
+    {
+        cout << "Error: incomplete calibration in " << opts.intrinsics << "/" << opts.extrinsics << endl;
+        return false;
+    }
+
+    // maps computed by an earlier run (or by stereo_calib -maps) are
+    // memory-mapped instead of recomputed
+    string mapsPath = opts.rectifyMaps.empty() ? rectifyMapsPath(opts.extrinsics) : opts.rectifyMaps;
+
+    VideoCapture cap[2];
+    bool isCamera[2];
+    for( int k = 0; k < 2; k++ )
+        if( !openSource(cap[k], opts.source[k], opts.frameSize, isCamera[k]) )
+        {
+            cout << "Error: can not open the video source " << opts.source[k] << endl;
+            return false;
+        }
+    bool drop = opts.dropFrames < 0 ? isCamera[0] || isCamera[1] : opts.dropFrames != 0;
+
+    DisparityEngine matcher(opts.disparity, opts.matchThreads, opts.matchStrips);
+
+    Metrics metrics;
+    if( !opts.metrics && !opts.metricsFile.empty() && !metrics.open(opts.metricsFile) )
+        cout << "Error: can not open the metrics file " << opts.metricsFile << endl;
+    Metrics* mp = opts.metrics ? opts.metrics : &metrics;
+
+    // Every queue can be full and every stage can hold one frame; with that
+    // many frames in the pool the capture stage never waits for a buffer.
+    int depth = std::max(opts.queueDepth, 1);
+    vector<StreamFrame> frames(3*depth + 4);
+    FrameQueue pool(frames.size()), rectifyQueue(depth), matchQueue(depth), outputQueue(depth);
+    for( size_t i = 0; i < frames.size(); i++ )
+        pool.push(&frames[i]);
+
+    std::atomic<bool> stop(false);
+    std::atomic<long> captured(0), dropped[3];
+    for( int i = 0; i < 3; i++ )
+        dropped[i] = 0;
+
+    std::thread captureThread([&]()
+    {
+        for( long index = 0; !stop; index++ )
+        {
+            StreamFrame* frame;
+            if( !pool.pop(frame) )
+                break;
+            StageTimer timer(mp, "capture", (int)index);
+            // grab both first so the two exposures are as close as possible
+            bool ok = cap[0].grab() && cap[1].grab() &&
+                      cap[0].retrieve(frame->raw[0]) && cap[1].retrieve(frame->raw[1]);
+            timer.stop();
+            if( !ok )
+            {
+                pool.push(frame);
+                break;
+            }
+            frame->index = index;
+            frame->captureTime = now();
+            captured++;
+            handOver(rectifyQueue, frame, drop, pool, dropped[0], mp, "capture");
+        }
+        rectifyQueue.close();
+    });
+
+    std::thread rectifyThread([&]()
+    {
+        RectifyMaps maps;
+        Mat roiMaps[2][2];   // the part of the maps that is rectified
+        StreamFrame* frame;
+        while( rectifyQueue.pop(frame) )
+        {
+            if( frame->raw[0].size() != maps.size() )
+            {
+                StageTimer mapTimer(mp, "initUndistortRectifyMap");
+                Size size = frame->raw[0].size();
+                Mat M[2] = { M1, M2 }, D[2] = { D1, D2 }, R[2] = { R1, R2 }, P[2] = { P1, P2 };
+                maps.loadOrCompute(mapsPath, M, D, R, P, size);
+
+                // The remap of a map ROI samples the whole source image, so
+                // cropping the maps is all it takes to skip the black
+                // borders. Both views keep the same columns, which leaves
+                // the disparities unchanged.
+                Rect roi(Point(), size);
+                if( opts.cropToValidRoi )
+                {
+                    Rect common = validRoi[0] & validRoi[1] & roi;
+                    if( common.area() > 0 )
+                    {
+                        roi = common;
+                        printf("rectifying %dx%d at (%d, %d), %.0f%% of the frame\n", roi.width, roi.height,
+                               roi.x, roi.y, 100.*roi.area()/size.area());
+                    }
+                    else
+                        cout << "Warning: no valid ROI in " << opts.extrinsics << ", rectifying the whole frame" << endl;
+                }
+                for( int k = 0; k < 2; k++ )
+                    for( int i = 0; i < 2; i++ )
+                        roiMaps[k][i] = maps.map(k, i)(roi);
+            }
+            StageTimer timer(mp, "rectify", (int)frame->index);
+            for( int k = 0; k < 2; k++ )
+            {
+                const Mat* src = &frame->raw[k];
+                if( src->channels() != 1 )
+                {
+                    cvtColor(*src, frame->gray[k], COLOR_BGR2GRAY);
+                    src = &frame->gray[k];
+                }
+                remap(*src, frame->rect[k], roiMaps[k][0], roiMaps[k][1], INTER_LINEAR);
+            }
+            timer.stop();
+            handOver(matchQueue, frame, drop, pool, dropped[1], mp, "rectify");
+        }
+        matchQueue.close();
+    });
+
+    std::thread matchThread([&]()
+    {
+        StreamFrame* frame;
+        while( matchQueue.pop(frame) )
+        {
+            StageTimer timer(mp, "disparity", (int)frame->index);
+            matcher.compute(frame->rect[0], frame->rect[1], frame->disp);
+            timer.stop();
+            handOver(outputQueue, frame, drop, pool, dropped[2], mp, "disparity");
+        }
+        outputQueue.close();
+    });
+
+    // OUTPUT STAGE, on this thread
+    VideoWriter writer;
+    Mat vdisp, canvas;
+    long output = 0;
+    double t0 = now(), lastReport = t0;
+    long lastOutput = 0;
+    StreamFrame* frame;
+    while( outputQueue.pop(frame) )
+    {
+        StageTimer timer(mp, "output", (int)frame->index);
+        const DisparityParams& dp = opts.disparity;
+        frame->disp.convertTo(vdisp, CV_8U, 255./(dp.numDisparities*16.), -255.*dp.minDisparity/dp.numDisparities);
+        if( !opts.videoOut.empty() )
+        {
+            if( !writer.isOpened() &&
+                !writer.open(opts.videoOut, VideoWriter::fourcc('M','J','P','G'), 30, vdisp.size(), false) )
+            {
+                cout << "Error: can not open the video output " << opts.videoOut << endl;
+                stop = true;
+            }
+            else
+                writer << vdisp;
+        }
+        bool quit = false;
+        if( opts.display )
+        {
+            const Mat& l = frame->rect[0];
+            const Mat& r = frame->rect[1];
+            canvas.create(l.rows, l.cols*2, CV_8U);
+            l.copyTo(canvas.colRange(0, l.cols));
+            r.copyTo(canvas.colRange(l.cols, l.cols*2));
+            for( int j = 0; j < canvas.rows; j += 16 )
+                line(canvas, Point(0, j), Point(canvas.cols, j), Scalar::all(255));
+            imshow("rectified", canvas);
+            imshow("disparity", vdisp);
+            quit = (waitKey(1) & 255) == 27;
+        }
+        timer.stop();
+        mp->record("latency", (now() - frame->captureTime)*1000., 0, (int)frame->index);
+        pool.push(frame);
+        output++;
+
+        double t = now();
+        if( t - lastReport >= 2 )
+        {
+            printf("%.1f fps, dropped %ld/%ld/%ld\n", (output - lastOutput)/(t - lastReport),
+                   (long)dropped[0], (long)dropped[1], (long)dropped[2]);
+            lastReport = t;
+            lastOutput = output;
+        }
+        if( quit || stop || (opts.maxFrames > 0 && output >= opts.maxFrames) )
+            break;
+    }
+
+    stop = true;
+    pool.close();
+    rectifyQueue.close();
+    matchQueue.close();
+    outputQueue.close();
+    captureThread.join();
+    rectifyThread.join();
+    matchThread.join();
+
+    double seconds = now() - t0;
+    printf("%ld frames captured, %ld shown in %.2f s (%.1f fps), dropped %ld before rectification, "
+           "%ld before matching, %ld before output\n", (long)captured, output, seconds,
+           seconds > 0 ? output/seconds : 0., (long)dropped[0], (long)dropped[1], (long)dropped[2]);
+    if( stats )
+    {
+        stats->captured = captured;
+        stats->output = output;
+        for( int i = 0; i < 3; i++ )
+            stats->dropped[i] = dropped[i];
+        stats->seconds = seconds;
+    }
+    return true;
+}
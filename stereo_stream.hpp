@@ -0,0 +1,52 @@
+#ifndef CALIB_STEREO_STREAM_HPP
+#define CALIB_STEREO_STREAM_HPP
+
+#include "opencv2/core/core.hpp"
+
+#include "disparity.hpp"
+
+#include <string>
+
+class Metrics;
+
+struct StereoStreamOptions
+{
+    StereoStreamOptions() : intrinsics("intrinsics.yml"), extrinsics("extrinsics.yml"),
+        queueDepth(2), dropFrames(-1), cropToValidRoi(false), matchThreads(0), matchStrips(0),
+        maxFrames(0), display(true), metrics(0) {}
+    std::string intrinsics, extrinsics;  // as written by StereoCalib, or their binary form (CalibFile)
+    std::string rectifyMaps; // map cache, empty = rectify_maps.bin next to extrinsics
+    std::string source[2];   // left and right: a camera index or a video file
+    cv::Size frameSize;      // camera resolution to request, empty = driver default
+    int queueDepth;          // frames buffered between two stages
+    int dropFrames;          // 1: drop the oldest frame when a stage falls behind,
+                             // 0: wait, -1: drop for cameras, wait for files
+    bool cropToValidRoi;     // rectify and match only where both rectified views have
+                             // valid pixels (validRoi1/2 of the extrinsics)
+    DisparityParams disparity;
+    int matchThreads;        // disparity workers, 0 = one per core
+    int matchStrips;         // strips per frame, 0 = one per worker
+    long maxFrames;          // stop after this many output frames, 0 = until the input ends
+    bool display;            // show the rectified pair and the disparity, ESC quits
+    std::string videoOut;    // write the disparity video here, empty = off
+    std::string metricsFile; // per-stage timings (JSON lines, or CSV for *.csv), empty = off
+    Metrics* metrics;        // if set, timings go here instead of to metricsFile
+};
+
+struct StereoStreamStats
+{
+    StereoStreamStats() : captured(0), output(0), seconds(0) { dropped[0] = dropped[1] = dropped[2] = 0; }
+    long captured, output;
+    long dropped[3];         // frames evicted before rectification, matching and output
+    double seconds;
+};
+
+// Rectifies and matches a live stereo stream. Capture, rectification and
+// matching each run on their own thread and hand frames over through
+// bounded queues; output (display, video) runs on the calling thread, as
+// HighGUI expects. Frame buffers come from a fixed pool and are recycled,
+// so nothing is allocated per frame once the pipeline is warm.
+// Returns false if the calibration or the sources could not be opened.
+bool runStereoStream(const StereoStreamOptions& opts, StereoStreamStats* stats = 0);
+
+#endif
@@ -0,0 +1,198 @@
+#include "opencv2/core/core.hpp"
+
+#include "../parallel.hpp"
+#include "../stereo_stream.hpp"
+
+#include <iostream>
+#include <string>
+#include <stdio.h>
+
+using namespace cv;
+using namespace std;
+
+static int print_help()
+{
+    cout << " Rectifies a live stereo stream with the calibration written by stereo_calib\n"
+            " and computes the disparity of every frame.\n" << endl;
+    cout << "Usage:\n ./stereo_stream [-intrinsics intrinsics.yml] [-extrinsics extrinsics.yml]\n"
+            "   /*YAML/XML or binary, see calib_convert*/\n"
+            "   [-maps rectify_maps.bin /*default: next to the extrinsics*/]\n"
+            "   [-size WxH /*camera resolution*/] [-queue depth] [-drop|-nodrop]\n"
+            "   [-crop /*rectify and match only the valid ROI of both views*/]\n"
+            "   [-ndisp n /*multiple of 16*/] [-mindisp n] [-block n /*odd*/] [-sgbm]\n"
+            "   [-uniqueness percent] [-speckle window range] [-mt threads /*0 = one per core*/]\n"
+            "   [-strips n /*0 = one per thread*/] [-cvthreads n /*OpenCV's own threads,\n"
+            "   default: 1 if several workers match*/] [-frames n]\n"
+            "   [-video disparity.avi] [-nodisplay] [-metrics file.jsonl|file.csv]\n"
+            "   left right /*camera indices or video files*/\n" << endl;
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    StereoStreamOptions opts;
+    DisparityParams& dp = opts.disparity;
+    int nsources = 0;
+    bool sgbm = false;
+    int uniqueness = -1, speckleWindow = -1, speckleRange = -1;
+    int cvThreads = -1;
+
+    for( int i = 1; i < argc; i++ )
+    {
+        string arg = argv[i];
+        bool hasValue = i+1 < argc;
+        if( arg == "-intrinsics" && hasValue )
+            opts.intrinsics = argv[++i];
+        else if( arg == "-extrinsics" && hasValue )
+            opts.extrinsics = argv[++i];
+        else if( arg == "-maps" && hasValue )
+            opts.rectifyMaps = argv[++i];
+        else if( arg == "-size" )
+        {
+            if( !hasValue || sscanf(argv[++i], "%dx%d", &opts.frameSize.width, &opts.frameSize.height) != 2 )
+            {
+                cout << "invalid frame size" << endl;
+                return print_help();
+            }
+        }
+        else if( arg == "-queue" )
+        {
+            if( !hasValue || sscanf(argv[++i], "%d", &opts.queueDepth) != 1 || opts.queueDepth <= 0 )
+            {
+                cout << "invalid queue depth" << endl;
+                return print_help();
+            }
+        }
+        else if( arg == "-drop" )
+            opts.dropFrames = 1;
+        else if( arg == "-nodrop" )
+            opts.dropFrames = 0;
+        else if( arg == "-crop" )
+            opts.cropToValidRoi = true;
+        else if( arg == "-ndisp" )
+        {
+            if( !hasValue || sscanf(argv[++i], "%d", &dp.numDisparities) != 1 ||
+                dp.numDisparities <= 0 || dp.numDisparities % 16 != 0 )
+            {
+                cout << "invalid number of disparities" << endl;
+                return print_help();
+            }
+        }
+        else if( arg == "-mindisp" )
+        {
+            if( !hasValue || sscanf(argv[++i], "%d", &dp.minDisparity) != 1 )
+            {
+                cout << "invalid minimum disparity" << endl;
+                return print_help();
+            }
+        }
+        else if( arg == "-block" )
+        {
+            if( !hasValue || sscanf(argv[++i], "%d", &dp.blockSize) != 1 ||
+                dp.blockSize < 1 || dp.blockSize % 2 == 0 )
+            {
+                cout << "invalid block size" << endl;
+                return print_help();
+            }
+        }
+        else if( arg == "-sgbm" )
+            sgbm = true;
+        else if( arg == "-uniqueness" )
+        {
+            if( !hasValue || sscanf(argv[++i], "%d", &uniqueness) != 1 || uniqueness < 0 )
+            {
+                cout << "invalid uniqueness ratio" << endl;
+                return print_help();
+            }
+        }
+        else if( arg == "-speckle" )
+        {
+            if( i+2 >= argc || sscanf(argv[i+1], "%d", &speckleWindow) != 1 ||
+                sscanf(argv[i+2], "%d", &speckleRange) != 1 || speckleWindow < 0 || speckleRange < 0 )
+            {
+                cout << "invalid speckle filter" << endl;
+                return print_help();
+            }
+            i += 2;
+        }
+        else if( arg == "-mt" )
+        {
+            if( !hasValue || sscanf(argv[++i], "%d", &opts.matchThreads) != 1 )
+            {
+                cout << "invalid thread count" << endl;
+                return print_help();
+            }
+        }
+        else if( arg == "-strips" )
+        {
+            if( !hasValue || sscanf(argv[++i], "%d", &opts.matchStrips) != 1 )
+            {
+                cout << "invalid strip count" << endl;
+                return print_help();
+            }
+        }
+        else if( arg == "-cvthreads" )
+        {
+            if( !hasValue || sscanf(argv[++i], "%d", &cvThreads) != 1 )
+            {
+                cout << "invalid OpenCV thread count" << endl;
+                return print_help();
+            }
+        }
+        else if( arg == "-frames" )
+        {
+            if( !hasValue || sscanf(argv[++i], "%ld", &opts.maxFrames) != 1 || opts.maxFrames < 0 )
+            {
+                cout << "invalid frame count" << endl;
+                return print_help();
+            }
+        }
+        else if( arg == "-video" && hasValue )
+            opts.videoOut = argv[++i];
+        else if( arg == "-nodisplay" )
+            opts.display = false;
+        else if( arg == "-metrics" && hasValue )
+            opts.metricsFile = argv[++i];
+        else if( arg == "--help" )
+            return print_help();
+        else if( arg[0] == '-' || nsources >= 2 )
+        {
+            cout << "invalid option " << arg << endl;
+            return print_help();
+        }
+        else
+            opts.source[nsources++] = arg;
+    }
+
+    if( nsources != 2 )
+        return print_help();
+    if( sgbm )
+    {
+        // the SGBM settings this tool has always used
+        dp.sgbm = true;
+        dp.preFilterCap = 63;
+        dp.uniquenessRatio = 10;
+        dp.speckleWindowSize = 100;
+        dp.speckleRange = 32;
+        dp.disp12MaxDiff = 1;
+    }
+    else if( dp.blockSize < 5 )
+    {
+        cout << "invalid block size" << endl;
+        return print_help();
+    }
+    if( uniqueness >= 0 )
+        dp.uniquenessRatio = uniqueness;
+    if( speckleWindow >= 0 )
+    {
+        dp.speckleWindowSize = speckleWindow;
+        dp.speckleRange = speckleRange;
+    }
+    // set once for the whole run: several strip workers already use the
+    // cores OpenCV's pool would
+    if( cvThreads < 0 && resolveThreadCount(opts.matchThreads) > 1 )
+        cvThreads = 1;
+    if( cvThreads >= 0 )
+        setNumThreads(cvThreads);
+    return runStereoStream(opts) ? 0 : -1;
+}
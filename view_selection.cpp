@@ -0,0 +1,114 @@
+#include "view_selection.hpp"
+
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+using namespace cv;
+using namespace std;
+
+ViewSelector::ViewSelector(Size _boardSize, int _capacity, double _minNovelty, double _minSharpness)
+    : boardSize(_boardSize), capacity(_capacity),
+      minNovelty(_minNovelty), minSharpness(_minSharpness)
+{
+    reset();
+}
+
+void ViewSelector::reset()
+{
+    bestSharpness = 0;
+    kept.clear();
+    poses.clear();
+    covered = Mat::zeros(GRID, GRID, CV_8U);
+}
+
+static double edgeLength(Point2f a, Point2f b)
+{
+    return std::max((double)norm(a - b), 1e-3);
+}
+
+bool ViewSelector::describe(const vector<Point2f>& corners, Pose& pose) const
+{
+    int w = boardSize.width, h = boardSize.height;
+    if( (int)corners.size() != w*h || imageSize.area() == 0 )
+        return false;
+
+    Point2f c00 = corners[0], c01 = corners[w-1], c10 = corners[(h-1)*w], c11 = corners[h*w-1];
+    Point2f outline[] = { c00, c01, c11, c10 };
+    double area = contourArea(Mat(4, 1, CV_32FC2, outline));
+    Scalar center = mean(Mat(corners));
+
+    pose.v[0] = center[0]/imageSize.width;
+    pose.v[1] = center[1]/imageSize.height;
+    pose.v[2] = sqrt(area/imageSize.area());
+    // a board turned about its vertical axis has one vertical edge longer
+    // than the other, and likewise for the horizontal axis
+    pose.v[3] = 2*log(edgeLength(c01, c11)/edgeLength(c00, c10));
+    pose.v[4] = 2*log(edgeLength(c10, c11)/edgeLength(c00, c01));
+    return true;
+}
+
+bool ViewSelector::offer(const vector<Point2f>& corners, Size _imageSize, const Mat& gray, ViewScore* score)
+{
+    if( _imageSize != imageSize )
+    {
+        reset();
+        imageSize = _imageSize;
+    }
+
+    ViewScore sc;
+    Pose pose;
+    if( !describe(corners, pose) )
+    {
+        if( score )
+            *score = sc;
+        return false;
+    }
+
+    sc.novelty = DBL_MAX;
+    for( size_t i = 0; i < poses.size(); i++ )
+    {
+        double d2 = 0;
+        for( int j = 0; j < POSE_DIMS; j++ )
+            d2 += (pose.v[j] - poses[i].v[j])*(pose.v[j] - poses[i].v[j]);
+        sc.novelty = std::min(sc.novelty, sqrt(d2));
+    }
+
+    Mat cells = Mat::zeros(GRID, GRID, CV_8U);
+    for( size_t i = 0; i < corners.size(); i++ )
+    {
+        int cx = std::min(std::max((int)(corners[i].x*GRID/imageSize.width), 0), GRID - 1);
+        int cy = std::min(std::max((int)(corners[i].y*GRID/imageSize.height), 0), GRID - 1);
+        if( !covered.at<uchar>(cy, cx) && !cells.at<uchar>(cy, cx) )
+        {
+            cells.at<uchar>(cy, cx) = 1;
+            sc.coverageGain++;
+        }
+    }
+
+    bool sharp = true;
+    if( !gray.empty() )
+    {
+        Rect roi = boundingRect(Mat(corners)) & Rect(Point(), gray.size());
+        if( roi.area() > 0 )
+        {
+            Laplacian(gray(roi), lap, CV_16S);
+            sc.sharpness = norm(lap, NORM_L2SQR)/roi.area();
+        }
+        bestSharpness = std::max(bestSharpness, sc.sharpness);
+        sharp = sc.sharpness >= minSharpness*bestSharpness;
+    }
+
+    sc.accepted = !full() && sharp && (sc.novelty >= minNovelty || sc.coverageGain >= MIN_COVERAGE_GAIN);
+    if( sc.accepted )
+    {
+        kept.push_back(corners);
+        poses.push_back(pose);
+        covered |= cells;
+    }
+    if( score )
+        *score = sc;
+    return sc.accepted;
+}
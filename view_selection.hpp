@@ -0,0 +1,71 @@
+#ifndef CALIB_VIEW_SELECTION_HPP
+#define CALIB_VIEW_SELECTION_HPP
+
+#include "opencv2/core/core.hpp"
+
+#include <vector>
+
+// How a candidate view compares to the views kept so far.
+struct ViewScore
+{
+    ViewScore() : novelty(0), coverageGain(0), sharpness(0), accepted(false) {}
+    double novelty;          // pose distance to the nearest kept view, DBL_MAX for the first
+    int coverageGain;        // image cells the board reaches for the first time
+    double sharpness;        // mean squared Laplacian over the board, 0 if no image was given
+    bool accepted;
+};
+
+// Picks a bounded, diverse set of calibration views from a stream of
+// detected boards.
+//
+// Every candidate is described by where the board sits in the image, how
+// much of it it fills and how far it is tilted, all read off the detected
+// corners (the tilt from the length ratios of opposite board edges), so no
+// calibration is needed yet. A candidate is kept if its pose is far enough
+// from every kept view or if it covers image cells no kept board reached;
+// views noticeably blurrier than the sharpest one offered so far are
+// rejected, as are all views once the set is full. The solver then works
+// on the views that constrain it instead of hundreds of near-identical
+// frames.
+class ViewSelector
+{
+public:
+    // boardSize: corners per row and column, as passed to the detector;
+    // capacity: most views kept; minNovelty: pose distance (in image
+    // fractions, tilt counting double) a view needs to be kept for its pose;
+    // minSharpness: fraction of the best sharpness seen a view needs.
+    ViewSelector(cv::Size boardSize, int capacity,
+                 double minNovelty = 0.1, double minSharpness = 0.3);
+
+    void reset();
+
+    // Scores the corners of a view, keeps them if they are informative and
+    // returns whether they were kept. gray is the 8-bit image the corners
+    // were found in; without it sharpness is not checked. A view of another
+    // image size starts a new set.
+    bool offer(const std::vector<cv::Point2f>& corners, cv::Size imageSize,
+               const cv::Mat& gray = cv::Mat(), ViewScore* score = 0);
+
+    int size() const { return (int)kept.size(); }
+    bool full() const { return size() >= capacity; }
+    const std::vector<std::vector<cv::Point2f> >& views() const { return kept; }
+
+private:
+    // coverage is counted on a GRID x GRID partition of the image; a few new
+    // cells, not one, so jitter at the board edge does not count as coverage
+    enum { GRID = 8, MIN_COVERAGE_GAIN = 3, POSE_DIMS = 5 };
+    struct Pose { double v[POSE_DIMS]; };
+
+    bool describe(const std::vector<cv::Point2f>& corners, Pose& pose) const;
+
+    cv::Size imageSize, boardSize;
+    int capacity;
+    double minNovelty, minSharpness;
+    double bestSharpness;
+    std::vector<std::vector<cv::Point2f> > kept;
+    std::vector<Pose> poses;
+    cv::Mat covered;         // GRID x GRID, nonzero where a kept board reached
+    cv::Mat lap;             // scratch
+};
+
+#endif
@@ -0,0 +1,312 @@
+#include "camera_calibration.hpp"
+
+#include <time.h>
+#include <stdio.h>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "../bundle_adjust.hpp"
+#include "../calib_errors.hpp"
+
+using namespace cv;
+using namespace std;
+
+bool findPattern(const Settings& s, const Mat& view, vector<Point2f>& pointBuf)
+{
+    bool found;
+    switch( s.calibrationPattern ) // Find feature points on the input format
+    {
+    case Settings::CHESSBOARD:
+        found = findChessboardCorners( view, s.boardSize, pointBuf, CHESSBOARD_DETECTION_FLAGS);
+        break;
+    case Settings::CIRCLES_GRID:
+        found = findCirclesGrid( view, s.boardSize, pointBuf );
+        break;
+    case Settings::ASYMMETRIC_CIRCLES_GRID:
+        found = findCirclesGrid( view, s.boardSize, pointBuf, CALIB_CB_ASYMMETRIC_GRID );
+        break;
+    default:
+        found = false;
+        break;
+    }
+
+    // improve the found corners' coordinate accuracy for chessboard
+    if( found && s.calibrationPattern == Settings::CHESSBOARD)
+    {
+        Mat viewGray;
+        cvtColor(view, viewGray, COLOR_BGR2GRAY);
+        cornerSubPix( viewGray, pointBuf, Size(11,11),
+            Size(-1,-1), TermCriteria( TermCriteria::EPS+TermCriteria::COUNT, 30, 0.1 ));
+    }
+    return found;
+}
+
+// calibrateCamera, or the sparse solver if the settings ask for it
+static double calibrate( const Settings& s, const vector<vector<Point3f> >& objectPoints,
+                         const vector<vector<Point2f> >& imagePoints, Size imageSize,
+                         Mat& cameraMatrix, Mat& distCoeffs, vector<Mat>& rvecs, vector<Mat>& tvecs, int flags )
+{
+    if( s.useSparseSolver )
+        return sparseCalibrateCamera(objectPoints, imagePoints, imageSize, cameraMatrix, distCoeffs,
+                                     rvecs, tvecs, flags);
+    return calibrateCamera(objectPoints, imagePoints, imageSize, cameraMatrix, distCoeffs,
+                           rvecs, tvecs, flags);
+}
+
+static void calcBoardCornerPositions(Size boardSize, float squareSize, vector<Point3f>& corners,
+                                     Settings::Pattern patternType /*= Settings::CHESSBOARD*/)
+{
+    corners.clear();
+
+    switch(patternType)
+    {
+    case Settings::CHESSBOARD:
+    case Settings::CIRCLES_GRID:
+        for( int i = 0; i < boardSize.height; ++i )
+            for( int j = 0; j < boardSize.width; ++j )
+                corners.push_back(Point3f(float( j*squareSize ), float( i*squareSize ), 0));
+        break;
+
+    case Settings::ASYMMETRIC_CIRCLES_GRID:
+        for( int i = 0; i < boardSize.height; i++ )
+            for( int j = 0; j < boardSize.width; j++ )
+                corners.push_back(Point3f(float((2*j + i % 2)*squareSize), float(i*squareSize), 0));
+        break;
+    default:
+        break;
+    }
+}
+
+bool runCalibration( Settings& s, Size& imageSize, Mat& cameraMatrix, Mat& distCoeffs,
+                            vector<vector<Point2f> > imagePoints, vector<Mat>& rvecs, vector<Mat>& tvecs,
+                            vector<float>& reprojErrs,  double& totalAvgErr)
+{
+
+    cameraMatrix = Mat::eye(3, 3, CV_64F);
+    if( s.flag & CALIB_FIX_ASPECT_RATIO )
+        cameraMatrix.at<double>(0,0) = 1.0;
+
+    distCoeffs = Mat::zeros(8, 1, CV_64F);
+
+    vector<vector<Point3f> > objectPoints(1);
+    calcBoardCornerPositions(s.boardSize, s.squareSize, objectPoints[0], s.calibrationPattern);
+
+    objectPoints.resize(imagePoints.size(),objectPoints[0]);
+
+    //Find intrinsic and extrinsic camera parameters
+    double rms = calibrate(s, objectPoints, imagePoints, imageSize, cameraMatrix,
+                           distCoeffs, rvecs, tvecs, s.flag|CALIB_FIX_K4|CALIB_FIX_K5);
+
+    cout << "Re-projection error reported by calibrateCamera: "<< rms << endl;
+
+    bool ok = checkRange(cameraMatrix) && checkRange(distCoeffs);
+
+    CalibErrors errors;
+    totalAvgErr = reprojectionErrors(objectPoints, imagePoints,
+                                     rvecs, tvecs, cameraMatrix, distCoeffs, errors);
+    reprojErrs.swap(errors.viewErrors);
+
+    return ok;
+}
+
+// Print camera parameters to the output file
+static void saveCameraParams( Settings& s, Size& imageSize, Mat& cameraMatrix, Mat& distCoeffs,
+                              const vector<Mat>& rvecs, const vector<Mat>& tvecs,
+                              const vector<float>& reprojErrs, const vector<vector<Point2f> >& imagePoints,
+                              double totalAvgErr )
+{
+    FileStorage fs( s.outputFileName, FileStorage::WRITE );
+
+    time_t tm;
+    time( &tm );
+    struct tm *t2 = localtime( &tm );
+    char buf[1024];
+    strftime( buf, sizeof(buf)-1, "%c", t2 );
+
+    fs << "calibration_Time" << buf;
+
+    if( !rvecs.empty() || !reprojErrs.empty() )
+        fs << "nrOfFrames" << (int)std::max(rvecs.size(), reprojErrs.size());
+    fs << "image_Width" << imageSize.width;
+    fs << "image_Height" << imageSize.height;
+    fs << "board_Width" << s.boardSize.width;
+    fs << "board_Height" << s.boardSize.height;
+    fs << "square_Size" << s.squareSize;
+
+    if( s.flag & CALIB_FIX_ASPECT_RATIO )
+        fs << "FixAspectRatio" << s.aspectRatio;
+
+    if( s.flag )
+    {
+        sprintf( buf, "flags: %s%s%s%s",
+            s.flag & CALIB_USE_INTRINSIC_GUESS ? " +use_intrinsic_guess" : "",
+            s.flag & CALIB_FIX_ASPECT_RATIO ? " +fix_aspectRatio" : "",
+            s.flag & CALIB_FIX_PRINCIPAL_POINT ? " +fix_principal_point" : "",
+            s.flag & CALIB_ZERO_TANGENT_DIST ? " +zero_tangent_dist" : "" );
+        fs.writeComment( buf );
+
+    }
+
+    fs << "flagValue" << s.flag;
+
+    fs << "Camera_Matrix" << cameraMatrix;
+    fs << "Distortion_Coefficients" << distCoeffs;
+
+    fs << "Avg_Reprojection_Error" << totalAvgErr;
+    if( !reprojErrs.empty() )
+        fs << "Per_View_Reprojection_Errors" << Mat(reprojErrs);
+
+    if( !rvecs.empty() && !tvecs.empty() )
+    {
+        CV_Assert(rvecs[0].type() == tvecs[0].type());
+        Mat bigmat((int)rvecs.size(), 6, rvecs[0].type());
+        for( int i = 0; i < (int)rvecs.size(); i++ )
+        {
+            Mat r = bigmat(Range(i, i+1), Range(0,3));
+            Mat t = bigmat(Range(i, i+1), Range(3,6));
+
+            CV_Assert(rvecs[i].rows == 3 && rvecs[i].cols == 1);
+            CV_Assert(tvecs[i].rows == 3 && tvecs[i].cols == 1);
+            //*.t() is MatExpr (not Mat) so we can use assignment operator
+            r = rvecs[i].t();
+            t = tvecs[i].t();
+        }
+        fs.writeComment( "a set of 6-tuples (rotation vector + translation vector) for each view" );
+        fs << "Extrinsic_Parameters" << bigmat;
+    }
+
+    if( !imagePoints.empty() )
+    {
+        Mat imagePtMat((int)imagePoints.size(), (int)imagePoints[0].size(), CV_32FC2);
+        for( int i = 0; i < (int)imagePoints.size(); i++ )
+        {
+            Mat r = imagePtMat.row(i).reshape(2, imagePtMat.cols);
+            Mat imgpti(imagePoints[i]);
+            imgpti.copyTo(r);
+        }
+        fs << "Image_points" << imagePtMat;
+    }
+}
+
+bool runCalibrationAndSave(Settings& s, Size imageSize, Mat&  cameraMatrix, Mat& distCoeffs,vector<vector<Point2f> > imagePoints )
+{
+    vector<Mat> rvecs, tvecs;
+    vector<float> reprojErrs;
+    double totalAvgErr = 0;
+
+    bool ok = runCalibration(s,imageSize, cameraMatrix, distCoeffs, imagePoints, rvecs, tvecs,
+                             reprojErrs, totalAvgErr);
+    cout << (ok ? "Calibration succeeded" : "Calibration failed")
+        << ". avg re projection error = "  << totalAvgErr ;
+
+    if( ok )
+        saveCameraParams( s, imageSize, cameraMatrix, distCoeffs, rvecs ,tvecs, reprojErrs,
+                            imagePoints, totalAvgErr);
+    return ok;
+}
+
+IncrementalCalibrator::IncrementalCalibrator(Settings& _s) : s(_s)
+{
+    reset();
+}
+
+void IncrementalCalibrator::reset()
+{
+    imagePoints.clear();
+    calcBoardCornerPositions(s.boardSize, s.squareSize, board, s.calibrationPattern);
+    K = Mat();
+    D = Mat();
+    rvecs.clear();
+    tvecs.clear();
+    imageSize = Size();
+    solved = saved = 0;
+    ok = false;
+    rmsErr = 0;
+}
+
+void IncrementalCalibrator::addView(const vector<Point2f>& corners)
+{
+    imagePoints.push_back(corners);
+}
+
+double IncrementalCalibrator::solve(bool warm, Mat& K1, Mat& D1, vector<Mat>& rvecs1, vector<Mat>& tvecs1)
+{
+    int flags = s.flag|CALIB_FIX_K4|CALIB_FIX_K5;
+    if( warm )
+    {
+        K1 = K.clone();
+        D1 = D.clone();
+        flags |= CALIB_USE_INTRINSIC_GUESS;
+    }
+    else
+    {
+        K1 = Mat::eye(3, 3, CV_64F);
+        if( s.flag & CALIB_FIX_ASPECT_RATIO )
+            K1.at<double>(0,0) = 1.0;
+        D1 = Mat::zeros(8, 1, CV_64F);
+    }
+    vector<vector<Point3f> > objectPoints(imagePoints.size(), board);
+    return calibrate(s, objectPoints, imagePoints, imageSize, K1, D1, rvecs1, tvecs1, flags);
+}
+
+bool IncrementalCalibrator::update(Size _imageSize)
+{
+    if( imagePoints.empty() )
+        return false;
+    if( solved == views() && _imageSize == imageSize )
+        return ok;
+
+    // a new image size invalidates the previous estimate
+    bool warm = ok && _imageSize == imageSize;
+    imageSize = _imageSize;
+
+    Mat K1, D1;
+    vector<Mat> rvecs1, tvecs1;
+    double rms1 = solve(warm, K1, D1, rvecs1, tvecs1);
+    bool ok1 = checkRange(K1) && checkRange(D1);
+    if( warm && (!ok1 || rms1 > 2*rmsErr) )
+    {
+        Mat K2, D2;
+        vector<Mat> rvecs2, tvecs2;
+        double rms2 = solve(false, K2, D2, rvecs2, tvecs2);
+        bool ok2 = checkRange(K2) && checkRange(D2);
+        if( ok2 && (!ok1 || rms2 < rms1) )
+        {
+            K1 = K2; D1 = D2;
+            rvecs1.swap(rvecs2); tvecs1.swap(tvecs2);
+            rms1 = rms2;
+            ok1 = ok2;
+            warm = false;
+        }
+    }
+
+    K = K1;
+    D = D1;
+    rvecs.swap(rvecs1);
+    tvecs.swap(tvecs1);
+    rmsErr = rms1;
+    ok = ok1;
+    solved = views();
+    cout << solved << " views: re-projection error reported by calibrateCamera: " << rmsErr
+         << (warm ? " (warm start)" : "") << endl;
+    return ok;
+}
+
+bool IncrementalCalibrator::updateAndSave(Size _imageSize)
+{
+    update(_imageSize);
+    if( solved == 0 || saved == solved )
+        return ok;
+    saved = solved;
+
+    vector<vector<Point3f> > objectPoints(imagePoints.size(), board);
+    CalibErrors errors;
+    double totalAvgErr = 0;
+    if( ok )
+        totalAvgErr = reprojectionErrors(objectPoints, imagePoints, rvecs, tvecs, K, D, errors);
+    cout << (ok ? "Calibration succeeded" : "Calibration failed")
+        << ". avg re projection error = "  << totalAvgErr << endl;
+    if( ok )
+        saveCameraParams(s, imageSize, K, D, rvecs, tvecs, errors.viewErrors, imagePoints, totalAvgErr);
+    return ok;
+}
@@ -0,0 +1,267 @@
+#ifndef CALIB_CAMERA_CALIBRATION_HPP
+#define CALIB_CAMERA_CALIBRATION_HPP
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/calib3d/calib3d.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+class Settings
+{
+public:
+    Settings() : goodInput(false) {}
+    enum Pattern { NOT_EXISTING, CHESSBOARD, CIRCLES_GRID, ASYMMETRIC_CIRCLES_GRID };
+    enum InputType {INVALID, CAMERA, VIDEO_FILE, IMAGE_LIST};
+
+    void write(cv::FileStorage& fs) const                    //Write serialization for this class
+    {
+        fs << "{" << "BoardSize_Width"  << boardSize.width
+                  << "BoardSize_Height" << boardSize.height
+                  << "Square_Size"         << squareSize
+                  << "Calibrate_Pattern" << patternToUse
+                  << "Calibrate_NrOfFrameToUse" << nrFrames
+                  << "Calibrate_FixAspectRatio" << aspectRatio
+                  << "Calibrate_AssumeZeroTangentialDistortion" << calibZeroTangentDist
+                  << "Calibrate_FixPrincipalPointAtTheCenter" << calibFixPrincipalPoint
+                  << "Calibrate_UseSparseSolver" << useSparseSolver
+
+                  << "Write_DetectedFeaturePoints" << bwritePoints
+                  << "Write_extrinsicParameters"   << bwriteExtrinsics
+                  << "Write_outputFileName"  << outputFileName
+
+                  << "Show_UndistortedImage" << showUndistorsed
+
+                  << "Input_FlipAroundHorizontalAxis" << flipVertical
+                  << "Input_Delay" << delay
+                  << "Input" << input
+                  << "Input_CornerCacheDir" << cornerCacheDir
+           << "}";
+    }
+    void read(const cv::FileNode& node)                      //Read serialization for this class
+    {
+        node["BoardSize_Width" ] >> boardSize.width;
+        node["BoardSize_Height"] >> boardSize.height;
+        node["Calibrate_Pattern"] >> patternToUse;
+        node["Square_Size"]  >> squareSize;
+        node["Calibrate_NrOfFrameToUse"] >> nrFrames;
+        node["Calibrate_FixAspectRatio"] >> aspectRatio;
+        node["Write_DetectedFeaturePoints"] >> bwritePoints;
+        node["Write_extrinsicParameters"] >> bwriteExtrinsics;
+        node["Write_outputFileName"] >> outputFileName;
+        node["Calibrate_AssumeZeroTangentialDistortion"] >> calibZeroTangentDist;
+        node["Calibrate_FixPrincipalPointAtTheCenter"] >> calibFixPrincipalPoint;
+        node["Calibrate_UseSparseSolver"] >> useSparseSolver;
+        node["Input_FlipAroundHorizontalAxis"] >> flipVertical;
+        node["Show_UndistortedImage"] >> showUndistorsed;
+        node["Input"] >> input;
+        node["Input_Delay"] >> delay;
+        node["Input_CornerCacheDir"] >> cornerCacheDir;
+        interprate();
+    }
+    void interprate()
+    {
+        goodInput = true;
+        if (boardSize.width <= 0 || boardSize.height <= 0)
+        {
+            std::cerr << "Invalid Board size: " << boardSize.width << " " << boardSize.height << std::endl;
+            goodInput = false;
+        }
+        if (squareSize <= 10e-6)
+        {
+            std::cerr << "Invalid square size " << squareSize << std::endl;
+            goodInput = false;
+        }
+        if (nrFrames <= 0)
+        {
+            std::cerr << "Invalid number of frames " << nrFrames << std::endl;
+            goodInput = false;
+        }
+
+        if (input.empty())      // Check for valid input
+                inputType = INVALID;
+        else
+        {
+            if (input[0] >= '0' && input[0] <= '9')
+            {
+                std::stringstream ss(input);
+                ss >> cameraID;
+                inputType = CAMERA;
+            }
+            else
+            {
+                if (readStringList(input, imageList))
+                    {
+                        inputType = IMAGE_LIST;
+                        nrFrames = (nrFrames < (int)imageList.size()) ? nrFrames : (int)imageList.size();
+                    }
+                else
+                    inputType = VIDEO_FILE;
+            }
+            if (inputType == CAMERA)
+                inputCapture.open(cameraID);
+            if (inputType == VIDEO_FILE)
+                inputCapture.open(input);
+            if (inputType != IMAGE_LIST && !inputCapture.isOpened())
+                    inputType = INVALID;
+        }
+        if (inputType == INVALID)
+        {
+            std::cerr << " Inexistent input: " << input;
+            goodInput = false;
+        }
+
+        flag = 0;
+        if(calibFixPrincipalPoint) flag |= cv::CALIB_FIX_PRINCIPAL_POINT;
+        if(calibZeroTangentDist)   flag |= cv::CALIB_ZERO_TANGENT_DIST;
+        if(aspectRatio)            flag |= cv::CALIB_FIX_ASPECT_RATIO;
+
+
+        calibrationPattern = NOT_EXISTING;
+        if (!patternToUse.compare("CHESSBOARD")) calibrationPattern = CHESSBOARD;
+        if (!patternToUse.compare("CIRCLES_GRID")) calibrationPattern = CIRCLES_GRID;
+        if (!patternToUse.compare("ASYMMETRIC_CIRCLES_GRID")) calibrationPattern = ASYMMETRIC_CIRCLES_GRID;
+        if (calibrationPattern == NOT_EXISTING)
+            {
+                std::cerr << " Inexistent camera calibration mode: " << patternToUse << std::endl;
+                goodInput = false;
+            }
+        atImageList = 0;
+
+    }
+    cv::Mat nextImage()
+    {
+        cv::Mat result;
+        if( inputCapture.isOpened() )
+        {
+            cv::Mat view0;
+            inputCapture >> view0;
+            view0.copyTo(result);
+        }
+        else if( atImageList < (int)imageList.size() )
+            result = cv::imread(imageList[atImageList++], cv::IMREAD_COLOR);
+
+        return result;
+    }
+
+    static bool readStringList( const std::string& filename, std::vector<std::string>& l )
+    {
+        l.clear();
+        cv::FileStorage fs(filename, cv::FileStorage::READ);
+        if( !fs.isOpened() )
+            return false;
+        cv::FileNode n = fs.getFirstTopLevelNode();
+        if( n.type() != cv::FileNode::SEQ )
+            return false;
+        cv::FileNodeIterator it = n.begin(), it_end = n.end();
+        for( ; it != it_end; ++it )
+            l.push_back((std::string)*it);
+        return true;
+    }
+public:
+    cv::Size boardSize;        // The size of the board -> Number of items by width and height
+    Pattern calibrationPattern;// One of the Chessboard, circles, or asymmetric circle pattern
+    float squareSize;          // The size of a square in your defined unit (point, millimeter,etc).
+    int nrFrames;              // The number of frames to use from the input for calibration
+    float aspectRatio;         // The aspect ratio
+    int delay;                 // In case of a video input
+    bool bwritePoints;         //  Write detected feature points
+    bool bwriteExtrinsics;     // Write extrinsic parameters
+    bool calibZeroTangentDist; // Assume zero tangential distortion
+    bool calibFixPrincipalPoint;// Fix the principal point at the center
+    bool useSparseSolver;       // Solve with sparseCalibrateCamera, for large view sets
+    bool flipVertical;          // Flip the captured images around the horizontal axis
+    std::string outputFileName; // The name of the file where to write
+    bool showUndistorsed;       // Show undistorted images after calibration
+    std::string input;          // The input ->
+    std::string cornerCacheDir; // Directory of the persistent corner cache (image lists only)
+
+
+
+    int cameraID;
+    std::vector<std::string> imageList;
+    int atImageList;
+    cv::VideoCapture inputCapture;
+    InputType inputType;
+    bool goodInput;
+    int flag;
+
+private:
+    std::string patternToUse;
+
+
+};
+
+inline void read(const cv::FileNode& node, Settings& x, const Settings& default_value = Settings())
+{
+    if(node.empty())
+        x = default_value;
+    else
+        x.read(node);
+}
+
+// Flags findPattern() passes to findChessboardCorners.
+const int CHESSBOARD_DETECTION_FLAGS = cv::CALIB_CB_ADAPTIVE_THRESH | cv::CALIB_CB_FAST_CHECK |
+                                       cv::CALIB_CB_NORMALIZE_IMAGE;
+
+// Finds the calibration pattern selected in the settings in a BGR view.
+// Chessboard corners are refined with cornerSubPix.
+bool findPattern(const Settings& s, const cv::Mat& view, std::vector<cv::Point2f>& pointBuf);
+
+bool runCalibration( Settings& s, cv::Size& imageSize, cv::Mat& cameraMatrix, cv::Mat& distCoeffs,
+                     std::vector<std::vector<cv::Point2f> > imagePoints,
+                     std::vector<cv::Mat>& rvecs, std::vector<cv::Mat>& tvecs,
+                     std::vector<float>& reprojErrs, double& totalAvgErr);
+
+bool runCalibrationAndSave(Settings& s, cv::Size imageSize, cv::Mat& cameraMatrix, cv::Mat& distCoeffs,
+                           std::vector<std::vector<cv::Point2f> > imagePoints );
+
+// Calibrates a camera incrementally, as views come in.
+//
+// Every update() solves with all views added so far, starting from the
+// previous estimate (CALIB_USE_INTRINSIC_GUESS) so the optimizer only has
+// to absorb the new views. Should the warm start end clearly worse than
+// the last solution it is solved once more from scratch and the better of
+// the two is kept. A solution is computed once per set of views: update()
+// and updateAndSave() return the current one when no view was added since,
+// and updateAndSave() writes every solution at most once.
+class IncrementalCalibrator
+{
+public:
+    explicit IncrementalCalibrator(Settings& s);
+
+    void reset();
+    void addView(const std::vector<cv::Point2f>& corners);
+
+    // Returns whether the current solution is usable.
+    bool update(cv::Size imageSize);
+    // update(), then saves a solution that has not been saved yet.
+    bool updateAndSave(cv::Size imageSize);
+
+    int views() const { return (int)imagePoints.size(); }
+    int solvedViews() const { return solved; }
+    bool upToDate() const { return solved == views(); }
+    bool valid() const { return ok; }
+    double rms() const { return rmsErr; }  // as reported by calibrateCamera
+    const cv::Mat& cameraMatrix() const { return K; }
+    const cv::Mat& distCoeffs() const { return D; }
+
+private:
+    double solve(bool warm, cv::Mat& K1, cv::Mat& D1,
+                 std::vector<cv::Mat>& rvecs1, std::vector<cv::Mat>& tvecs1);
+
+    Settings& s;
+    std::vector<std::vector<cv::Point2f> > imagePoints;
+    std::vector<cv::Point3f> board;
+    cv::Mat K, D;
+    std::vector<cv::Mat> rvecs, tvecs;
+    cv::Size imageSize;
+    int solved, saved;
+    bool ok;
+    double rmsErr;
+};
+
+#endif